@@ -21,8 +21,10 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <time.h>
+#include <errno.h>
 
 #ifdef __unix
+#include <unistd.h>
 #define HAVE_byteswap
 #define HAVE_inttypes
 #define HAVE_setjmp_and_signal
@@ -48,6 +50,7 @@
 #ifndef bswap_64
 #define bswap_64(x) (bswap_32(x)<<32 | bswap_32(x>>32))
 #endif
+#define noswap(x) (x)
 
 #ifdef HAVE_inttypes
 #include <inttypes.h>
@@ -68,12 +71,28 @@
 #define strtoull strtoul
 #endif
 
+#ifdef __linux
+#include <sched.h>
+#endif
+
+#include "epicsVersion.h"
+#ifdef VERSION_INT
+#if EPICS_VERSION_INT >= VERSION_INT(3,15,0,2)
+#define HAVE_epicsThreadGetCPUs
+#endif
+#endif
+#include "epicsThread.h"
+#include "cantProceed.h"
+#include "epicsEvent.h"
+#include "epicsMutex.h"
 #include "epicsExport.h"
 
 #include "memDisplay.h"
+#include "memDisplayPriv.h"
 #undef memDisplay
 
 int memDisplayDebug;
+int memDisplayAsync;
 
 int memDisplay(size_t base, volatile void* ptr, int wordsize, size_t bytes)
 {
@@ -83,11 +102,49 @@ int memDisplay(size_t base, volatile void* ptr, int wordsize, size_t bytes)
 #ifdef HAVE_setjmp_and_signal
 /* Setup handler to catch access to invalid addresses (avoids crash) */
 
-static sigjmp_buf addressFailEnv;
+/* Each thread has its own jump buffer so that worker threads can catch
+   their own faults while the main thread keeps the handlers installed.
+   armed is 1 in the thread which installed the handlers and
+   2 in worker threads. */
+struct faultCatcher {
+    sigjmp_buf env;
+    int armed;
+    void* addr;             /* of the last caught fault, NULL if unknown */
+};
+static epicsThreadOnceId faultCatcherOnce = EPICS_THREAD_ONCE_INIT;
+static epicsThreadPrivateId faultCatcherId;
+
+static void faultCatcherInit(void* arg)
+{
+    (void)arg;
+    faultCatcherId = epicsThreadPrivateCreate();
+}
+
+static struct faultCatcher* getFaultCatcher(void)
+{
+    struct faultCatcher* fc;
+
+    epicsThreadOnce(&faultCatcherOnce, faultCatcherInit, NULL);
+    fc = epicsThreadPrivateGet(faultCatcherId);
+    if (!fc)
+    {
+        fc = callocMustSucceed(1, sizeof(struct faultCatcher), "getFaultCatcher");
+        epicsThreadPrivateSet(faultCatcherId, fc);
+    }
+    return fc;
+}
+
+static void releaseFaultCatcher(void)
+{
+    free(epicsThreadPrivateGet(faultCatcherId));
+    epicsThreadPrivateSet(faultCatcherId, NULL);
+}
+
 static struct sigaction oldsigsegv, oldsigbus;
 
 static void signalsOff()
 {
+    getFaultCatcher()->armed = 0;
     sigaction(SIGSEGV, &oldsigsegv, NULL);
     sigaction(SIGBUS, &oldsigbus, NULL);
     if (memDisplayDebug)
@@ -95,15 +152,62 @@ static void signalsOff()
             SIGSEGV, SIGBUS);
 }
 
+#define MAX_FAULT_FILTERS 8
+static memDisplayFaultFilter faultFilters[MAX_FAULT_FILTERS];
+
+void memDisplayInstallFaultFilter(memDisplayFaultFilter filter)
+{
+    int i;
+
+    for (i = 0; i < MAX_FAULT_FILTERS; i++)
+    {
+        if (faultFilters[i] == filter) return;
+        if (!faultFilters[i])
+        {
+            faultFilters[i] = filter;
+            return;
+        }
+    }
+    fprintf(stderr, "Too many fault filters.\n");
+}
+
+int memDisplayFilterFault(int sig, void *info, void *ctx)
+{
+    int i;
+
+    for (i = 0; i < MAX_FAULT_FILTERS && faultFilters[i]; i++)
+    {
+        int s = faultFilters[i](sig, info, ctx);
+        if (s != sig) return s;
+    }
+    return sig;
+}
+
 static void sigAction(int sig, siginfo_t *info, void *ctx)
 {
+    int report = memDisplayFilterFault(sig, info, ctx);
+    struct faultCatcher* fc;
+
+    if (report == 0)
+        return;
+    fc = faultCatcherId ? epicsThreadPrivateGet(faultCatcherId) : NULL;
+    if (!fc || !fc->armed)
+    {
+        /* not our thread: restore original handler and let the access fault again */
+        sigaction(sig, sig == SIGBUS ? &oldsigbus : &oldsigsegv, NULL);
+        return;
+    }
 #ifdef si_addr
-    fprintf(stderr, "%s at address %p.\n", strsignal(sig), info->si_addr);
+    fprintf(stderr, "%s at address %p.\n", strsignal(report), info->si_addr);
+    fc->addr = info->si_addr;
 #else
-    fprintf(stderr, "%s\n", strsignal(sig));
+    fprintf(stderr, "%s\n", strsignal(report));
+    fc->addr = NULL;
 #endif
-    signalsOff();
-    siglongjmp(addressFailEnv, 1);
+    if (fc->armed == 1)
+        signalsOff();
+    fc->armed = 0;
+    siglongjmp(fc->env, 1);
 }
 
 static void signalsOn()
@@ -117,21 +221,208 @@ static void signalsOn()
         fprintf(stderr, "Signal handlers installed for SIGSEGV(%d) and SIGBUS(%d)\n",
             SIGSEGV, SIGBUS);
 }
-#define catchSignals() (signalsOn(), sigsetjmp(addressFailEnv, 1))
+#define catchSignals() (signalsOn(), getFaultCatcher()->armed = 1, sigsetjmp(getFaultCatcher()->env, 1))
+
+/* in worker threads while the main thread has called signalsOn() */
+#define catchSignalsInThread() (getFaultCatcher()->armed = 2, sigsetjmp(getFaultCatcher()->env, 1))
+#define releaseSignalsInThread() releaseFaultCatcher()
+#define faultAddress() (getFaultCatcher()->addr)
 
 #else
+void memDisplayInstallFaultFilter(memDisplayFaultFilter filter)
+{
+    fprintf(stderr, "Fault filters not supported on this system.\n");
+}
+
+int memDisplayFilterFault(int sig, void *info, void *ctx)
+{
+    return sig;
+}
+
 #define catchSignals() 0
+#define signalsOn()
 #define signalsOff()
+#define catchSignalsInThread() 0
+#define releaseSignalsInThread()
+#define faultAddress() NULL
 #endif
 
-int fmemDisplay(FILE* file, size_t base, volatile void* ptr, int wordsize, size_t bytes)
+/* Line formatting: the hex and ASCII text of a whole line is built in a
+   buffer and written at once. The common layouts get their own copy of
+   the formatting loop with wordsize, line size and grouping as constants. */
+
+#define MAX_LINE_BYTES 256
+#define LINE_BUFFER_SIZE (16 + 2 + 3 * MAX_LINE_BYTES + 2 + MAX_LINE_BYTES + 1)
+
+#if defined(__GNUC__)
+#define FORMAT_INLINE static __inline__ __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define FORMAT_INLINE static __forceinline
+#else
+#define FORMAT_INLINE static
+#endif
+
+static const char hexdigits[] = "0123456789abcdef";
+
+FORMAT_INLINE char* formatWord(char* q, const unsigned char* data, int wordsize)
+{
+    uint64_t x;
+    int k;
+
+    switch (wordsize)
+    {
+        case 1:
+            x = *data;
+            break;
+        case 2:
+        {
+            uint16_t v;
+            memcpy(&v, data, 2);
+            x = v;
+            break;
+        }
+        case 4:
+        {
+            uint32_t v;
+            memcpy(&v, data, 4);
+            x = v;
+            break;
+        }
+        default:
+            memcpy(&x, data, 8);
+            break;
+    }
+    for (k = 2 * wordsize - 1; k >= 0; k--)
+    {
+        q[k] = hexdigits[x & 15];
+        x >>= 4;
+    }
+    return q + 2 * wordsize;
+}
+
+/* words in [first, last) are valid, the others are left blank,
+   ascii is the number of bytes shown as text */
+FORMAT_INLINE size_t formatLine(char* out, unsigned long long offset, int addrdigits,
+    const unsigned char* data, int wordsize, int linesize, int group, int ascii, int first, int last)
+{
+    char* q = out;
+    int j, k;
+
+    for (k = addrdigits - 1; k >= 0; k--)
+    {
+        q[k] = hexdigits[offset & 15];
+        offset >>= 4;
+    }
+    q += addrdigits;
+    *q++ = ':';
+    *q++ = ' ';
+    for (j = 0; j < linesize; j += wordsize)
+    {
+        if (j < first || j >= last)
+        {
+            memset(q, ' ', 2 * wordsize);
+            q += 2 * wordsize;
+        }
+        else
+            q = formatWord(q, data + j, wordsize);
+        if ((j + wordsize) % group == 0)
+            *q++ = ' ';
+    }
+    if (ascii)
+    {
+        *q++ = '|';
+        *q++ = ' ';
+        for (j = 0; j < ascii; j++)
+        {
+            unsigned char c = data[j];
+            *q++ = j < first ? ' ' : c >= 0x20 && c < 0x7f ? c : '.';
+        }
+    }
+    else
+        while (q[-1] == ' ') q--;
+    *q++ = '\n';
+    return q - out;
+}
+
+typedef size_t (*lineFormatter)(char* out, unsigned long long offset, int addrdigits,
+    const unsigned char* data, int ascii);
+
+#define LINE_FORMATS(X) \
+    X(1, 16) X(2, 16) X(4, 16) X(8, 16) \
+    X(1, 32) X(2, 32) X(4, 32) X(8, 32) \
+    X(1, 64) X(2, 64) X(4, 64) X(8, 64)
+
+#define LINE_FORMATTER(w, l) \
+static size_t formatLine_##w##_##l(char* out, unsigned long long offset, int addrdigits, \
+    const unsigned char* data, int ascii) \
+{ \
+    return ascii ? formatLine(out, offset, addrdigits, data, w, l, w, l, 0, l) : \
+        formatLine(out, offset, addrdigits, data, w, l, w, 0, 0, l); \
+}
+LINE_FORMATS(LINE_FORMATTER)
+
+#define LINE_FORMATTER_ENTRY(w, l) { w, l, formatLine_##w##_##l },
+static const struct {
+    int wordsize;
+    int linesize;
+    lineFormatter format;
+} lineFormatters[] = {
+    LINE_FORMATS(LINE_FORMATTER_ENTRY)
+};
+
+static lineFormatter findLineFormatter(int wordsize, int linesize, int group)
+{
+    size_t i;
+
+    if (group != wordsize) return NULL;
+    for (i = 0; i < sizeof(lineFormatters)/sizeof(lineFormatters[0]); i++)
+        if (lineFormatters[i].wordsize == wordsize && lineFormatters[i].linesize == linesize)
+            return lineFormatters[i].format;
+    return NULL;
+}
+
+static int checkLineFormat(int abswordsize, int* linesize, int* group)
 {
-    unsigned char buffer[16];
-    unsigned long long offset;
-    size_t i, j, len = 0;
+    if (*linesize == 0) *linesize = 16;
+    if (*group == 0) *group = abswordsize;
+    if (*linesize < 0 || *linesize > MAX_LINE_BYTES || *linesize % abswordsize)
+    {
+        fprintf(stdout, "Invalid line size %d: must be a multiple of wordsize up to %d\n",
+            *linesize, MAX_LINE_BYTES);
+        return -1;
+    }
+    if (*group < 0 || *group % abswordsize || *linesize % *group)
+    {
+        fprintf(stdout, "Invalid group size %d: must be a multiple of wordsize dividing the line size\n",
+            *group);
+        return -1;
+    }
+    return 0;
+}
+
+#define READ_LINE(type, swap) \
+    for (j = first; j < last; j += sizeof(type)) \
+    { \
+        type x = *(volatile type*)(p + j); \
+        x = (type)swap(x); \
+        memcpy(data + j, &x, sizeof(type)); \
+    }
+
+/* Without catchFaults the memory must be known to be valid, e.g. a snapshot */
+static int displayMemory(FILE* file, size_t base, volatile void* ptr, int wordsize, size_t bytes,
+    int linesize, int group, int ascii, int catchFaults)
+{
+    unsigned char data[MAX_LINE_BYTES];
+    char line[LINE_BUFFER_SIZE];
+    lineFormatter format;
     int abswordsize = abs(wordsize);
-    size_t size, mask;
-    volatile char *p = ptr;
+    int first, last, j;
+    size_t size, mask, head, n;
+    volatile char *start = ptr, *p;
+
+    /* modified after sigsetjmp, thus volatile */
+    volatile size_t i = 0, len = 0;
+    volatile unsigned long long offset;
 
     int addr_wordsize = ((base + bytes - 1) & UINT64_C(0xffff000000000000)) ? 16 :
                         ((base + bytes - 1) &     UINT64_C(0xffff00000000)) ? 12 :
@@ -152,8 +443,9 @@ int fmemDisplay(FILE* file, size_t base, volatile void* ptr, int wordsize, size_
             fprintf(stdout, "Invalid data wordsize %d\n", wordsize);
             return -1;
     }
-
-    memset(buffer, ' ', sizeof(buffer));
+    if (checkLineFormat(abswordsize, &linesize, &group) != 0)
+        return -1;
+    format = findLineFormatter(abswordsize, linesize, group);
 
     if (memDisplayDebug)
         fprintf(stderr, "memDisplay: base=0x%llx ptr=%p wordsize=%d bytes=%llu\n",
@@ -161,215 +453,925 @@ int fmemDisplay(FILE* file, size_t base, volatile void* ptr, int wordsize, size_
 
     /* align start to wordsize */
     mask = abs(wordsize)-1;
-    p = (volatile void*)((size_t)p - (base & mask));
+    start = (volatile void*)((size_t)start - (base & mask));
     base &= ~mask;
 
     if (memDisplayDebug)
         fprintf(stderr, "memDisplay: Adjusted base=0x%llx ptr=%p wordsize=%d\n",
-            (unsigned long long)base, p, wordsize);
+            (unsigned long long)base, start, wordsize);
 
-    /* round down start address to multiple of 16 */
-    offset = base & ~15;
-    size = bytes + (base & 15);
-    p = (char*)((size_t)p - (base & 15));
+    /* round down start address to multiple of linesize */
+    head = base % linesize;
+    offset = base - head;
+    size = bytes + head;
+    start = (char*)((size_t)start - head);
 
     if (memDisplayDebug)
         fprintf(stderr, "memDisplay: Round down base=0x%llx ptr=%p offset=%llu size=%llu\n",
-            (unsigned long long)base, p, offset, (unsigned long long)size);
-
-    if (catchSignals()) {
-        fprintf(file, "<aborted>\n");
-        return -1;
-    }
-    for (i = 0; i < size; i += 16)
-    {
-        len += fprintf(file, "%0*llx: ", addr_wordsize, offset);
-        for (j = 0; j < 16; j += abswordsize) {
-            if (offset + j < base || i + j >= size)
-                len += fprintf(file, "%*c ", 2*abswordsize, ' ');
-            else
-            {
-                switch (wordsize)
-                {
-                    case 1:
-                    case -1:
-                    {
-                        uint8_t x = *(volatile uint8_t*)p;
-                        *(uint8_t*)(buffer + j) = x;
-                        len += fprintf(file, "%02" PRIx8 " ", x);
-                        break;
-                    }
-                    case 2:
-                    {
-                        uint16_t x = *(volatile uint16_t*)p;
-                        *(uint16_t*)(buffer + j) = x;
-                        len += fprintf(file, "%04" PRIx16 " ", x);
-                        break;
-                    }
-                    case 4:
-                    {
-                        uint32_t x = *(volatile uint32_t*)p;
-                        *(uint32_t*)(buffer + j) = x;
-                        len += fprintf(file, "%08" PRIx32 " ", x);
-                        break;
-                    }
-                    case 8:
-                    {
-                        uint64_t x = *(volatile uint64_t*)p;
-                        *(uint64_t*)(buffer + j) = x;
-                        len += fprintf(file, "%016" PRIx64 " ", x);
-                        break;
-                    }
-                    case -2:
-                    {
-                        uint16_t x = *(volatile uint16_t*)p;
-                        x = bswap_16(x);
-                        *(uint16_t*)(buffer + j) = x;
-                        len += fprintf(file, "%04" PRIx16 " ", x);
-                        break;
-                    }
-                    case -4:
-                    {
-                        uint32_t x = *(volatile uint32_t*)p;
-                        x = bswap_32(x);
-                        *(uint32_t*)(buffer + j) = x;
-                        len += fprintf(file, "%08" PRIx32 " ", x);
-                        break;
-                    }
-                    case -8:
-                    {
-                        uint64_t x = *(volatile uint64_t*)p;
-                        x = bswap_64(x);
-                        *(uint64_t*)(buffer + j) = x;
-                        len += fprintf(file, "%016" PRIx64 " ", x);
-                       break;
-                    }
-                }
-            }
-            p += abswordsize;
-        }
-        fprintf(file, "| ");
-        for (j = 0; j < 16; j++)
-        {
-            if (i + j >= size) break;
-            len += fprintf(file, "%c", isprint(buffer[j]) ? buffer[j] : '.');
-        }
-        offset += 16;
-        len += fprintf(file, "\n");
-    }
-    signalsOff();
-    return (int)len;
-}
+            (unsigned long long)base, start, offset, (unsigned long long)size);
 
-int memfill(volatile void* address, int pattern, size_t size, int wordsize, int increment)
-{
-    size_t i;
-    int abswordsize;
+    if (catchFaults && catchSignals()) {
+        /* print what has been read of the line up to the faulting word */
+        volatile char* fault = faultAddress();
+        int done;
 
-    if (!wordsize) {
-        if (pattern & 0xffff0000) wordsize=4;
-        else if (pattern & 0xff00) wordsize=2;
-        else wordsize=1;
+        p = start + i;
+        first = i == 0 ? (int)head : 0;
+        done = fault > p + first && fault < p + linesize ? (int)((fault - p) & ~mask) : first;
+        n = formatLine(line, offset, addr_wordsize, data, abswordsize, done, group, 0, first, done);
+        fwrite(line, 1, n - 1, file);
+        fprintf(file, " <aborted>\n");
+        return -1;
     }
-    abswordsize = abs(wordsize);
-
-    if (catchSignals()) return -1;
-    for (i = 0; i < size/abswordsize; i++)
+    for (; i < size; i += linesize)
     {
+        p = start + i;
+        first = i == 0 ? (int)head : 0;
+        last = size - i < (size_t)linesize ? (int)((size - i + mask) & ~mask) : linesize;
         switch (wordsize)
         {
-            case 0:
             case 1:
             case -1:
-                ((volatile uint8_t*)address)[i] = pattern;
+                READ_LINE(uint8_t, noswap);
                 break;
             case 2:
-                ((volatile uint16_t*)address)[i] = pattern;
+                READ_LINE(uint16_t, noswap);
                 break;
             case 4:
-                ((volatile uint32_t*)address)[i] = pattern;
+                READ_LINE(uint32_t, noswap);
+                break;
+            case 8:
+                READ_LINE(uint64_t, noswap);
                 break;
             case -2:
-                ((volatile uint16_t*)address)[i] = bswap_16(pattern);
+                READ_LINE(uint16_t, bswap_16);
                 break;
             case -4:
-                ((volatile uint32_t*)address)[i] = bswap_32(pattern);
+                READ_LINE(uint32_t, bswap_32);
+                break;
+            case -8:
+                READ_LINE(uint64_t, bswap_64);
                 break;
-            default:
-                fprintf(stderr, "Illegal wordsize %d: must be 1, 2, 4, -2, -4\n", wordsize);
-                signalsOff();
-                return -1;
         }
-        pattern += increment;
+        if (format && first == 0 && size - i >= (size_t)linesize)
+            n = format(line, offset, addr_wordsize, data, ascii);
+        else
+            n = formatLine(line, offset, addr_wordsize, data, abswordsize, linesize, group,
+                ascii ? (int)(size - i < (size_t)linesize ? size - i : (size_t)linesize) : 0, first, last);
+        fwrite(line, 1, n, file);
+        /* the "| " before the text is not counted, as always */
+        len += ascii ? n - 2 : n;
+        offset += linesize;
     }
-    signalsOff();
-    return 0;
+    if (catchFaults)
+        signalsOff();
+    return (int)len;
 }
 
-int memcopy(const volatile void* source, volatile void* dest, size_t size, int wordsize)
+int fmemDisplay(FILE* file, size_t base, volatile void* ptr, int wordsize, size_t bytes)
 {
-    size_t i;
-    struct timespec start, finished;
-    double sec;
+    return displayMemory(file, base, ptr, wordsize, bytes, 16, 0, 1, 1);
+}
+
+int memDisplayFormatData(FILE* file, size_t base, const void* data, int wordsize, size_t bytes)
+{
+    return displayMemory(file, base, (volatile void*)data, wordsize, bytes, 16, 0, 1, 0);
+}
+
+int fmemDisplayFormat(FILE* file, size_t base, volatile void* ptr, int wordsize, size_t bytes,
+    int linesize, int group, int ascii)
+{
+    return displayMemory(file, base, ptr, wordsize, bytes, linesize, group, ascii, 1);
+}
+
+/* Asynchronous output: snapshot the memory, format and write in the background */
+
+#define ASYNC_SLOTS 16
+#define ASYNC_BYTES 0x4000000
+
+struct asyncJob {
+    FILE* file;
+    size_t base;
+    int wordsize;
+    size_t bytes;
+    int linesize;
+    int group;
+    int ascii;
+    union {                 /* aligned for words up to 8 bytes */
+        char bytes[1];
+        uint64_t align;
+    } data;
+};
+
+static struct {
+    struct asyncJob* ring[ASYNC_SLOTS];
+    unsigned int head, tail;    /* head == tail: empty */
+    size_t queuedBytes;
+    epicsMutexId lock;
+    epicsEventId jobAvailable;
+    epicsEventId spaceAvailable;
+    epicsEventId idle;
+} async;
+
+static void asyncWriterThread(void* arg)
+{
+    struct asyncJob* job;
+
+    (void)arg;
+
+    while (1)
+    {
+        epicsMutexMustLock(async.lock);
+        while (async.head == async.tail)
+        {
+            epicsEventSignal(async.idle);
+            epicsMutexUnlock(async.lock);
+            epicsEventMustWait(async.jobAvailable);
+            epicsMutexMustLock(async.lock);
+        }
+        job = async.ring[async.tail % ASYNC_SLOTS];
+        epicsMutexUnlock(async.lock);
+
+        displayMemory(job->file, job->base, job->data.bytes, job->wordsize, job->bytes,
+            job->linesize, job->group, job->ascii, 0);
+        fflush(job->file);
+
+        epicsMutexMustLock(async.lock);
+        async.tail++;
+        async.queuedBytes -= job->bytes;
+        epicsMutexUnlock(async.lock);
+        epicsEventSignal(async.spaceAvailable);
+        free(job);
+    }
+}
+
+static epicsThreadOnceId asyncOnce = EPICS_THREAD_ONCE_INIT;
+static int asyncStatus;
+
+static void asyncInitOnce(void* arg)
+{
+    (void)arg;
+    async.lock = epicsMutexCreate();
+    async.jobAvailable = epicsEventCreate(epicsEventEmpty);
+    async.spaceAvailable = epicsEventCreate(epicsEventEmpty);
+    async.idle = epicsEventCreate(epicsEventEmpty);
+    if (!async.lock || !async.jobAvailable || !async.spaceAvailable || !async.idle ||
+        !epicsThreadCreate("memDisplay", epicsThreadPriorityLow,
+            epicsThreadGetStackSize(epicsThreadStackMedium), asyncWriterThread, NULL))
+    {
+        fprintf(stderr, "Creating memDisplay writer thread failed\n");
+        asyncStatus = -1;
+    }
+}
+
+static int asyncInit(void)
+{
+    epicsThreadOnce(&asyncOnce, asyncInitOnce, NULL);
+    return asyncStatus;
+}
+
+int fmemDisplayAsync(FILE* file, size_t base, volatile void* ptr, int wordsize, size_t bytes)
+{
+    return fmemDisplayAsyncFormat(file, base, ptr, wordsize, bytes, 16, 0, 1);
+}
+
+int fmemDisplayAsyncFormat(FILE* file, size_t base, volatile void* ptr, int wordsize, size_t bytes,
+    int linesize, int group, int ascii)
+{
+    struct asyncJob* job;
+    memReadVector vec;
+    int abswordsize = abs(wordsize);
+    size_t mask;
 
-    if (catchSignals()) return -1;
-    clock_gettime(CLOCK_MONOTONIC, &start);
     switch (wordsize)
     {
-        case 0:
-            memcpy((void*)dest, (const void*)source, size);
-            break;
         case 1:
-        case -1:
-            for (i = 0; i < size; i++)
-                ((volatile uint8_t*)dest)[i] = ((const volatile uint8_t*)source)[i];
-            break;
         case 2:
-            for (i = 0; i < size/2; i++)
-                ((volatile uint16_t*)dest)[i] = ((const volatile uint16_t*)source)[i];
-            break;
         case 4:
-            for (i = 0; i < size/4; i++)
-                ((volatile uint32_t*)dest)[i] = ((const volatile uint32_t*)source)[i];
-            break;
         case 8:
-            for (i = 0; i < size/8; i++)
-                ((volatile uint64_t*)dest)[i] = ((const volatile uint64_t*)source)[i];
-            break;
+        case -1:
         case -2:
-            for (i = 0; i < size/2; i++)
-                ((volatile uint16_t*)dest)[i] = bswap_16(((const volatile uint16_t*)source)[i]);
-            break;
         case -4:
-            for (i = 0; i < size/4; i++)
-                ((volatile uint32_t*)dest)[i] = bswap_32(((const volatile uint32_t*)source)[i]);
-            break;
         case -8:
-            for (i = 0; i < size/8; i++)
-                ((volatile uint64_t*)dest)[i] = bswap_64(((const volatile uint64_t*)source)[i]);
             break;
         default:
-            fprintf(stderr, "Illegal wordsize %d: must be 1, 2, 4, 8, -2, -4, -8\n", wordsize);
-            signalsOff();
+            fprintf(stdout, "Invalid data wordsize %d\n", wordsize);
             return -1;
     }
-    clock_gettime(CLOCK_MONOTONIC, &finished);
-    signalsOff();
-    finished.tv_sec  -= start.tv_sec;
-    if ((finished.tv_nsec -= start.tv_nsec) < 0)
+    if (checkLineFormat(abswordsize, &linesize, &group) != 0)
+        return -1;
+
+    /* align start to wordsize and read whole words */
+    mask = abswordsize-1;
+    ptr = (volatile char*)ptr - (base & mask);
+    bytes = (bytes + (base & mask) + mask) & ~mask;
+    base &= ~mask;
+
+    job = malloc(sizeof(struct asyncJob) + bytes);
+    if (!job)
     {
-        finished.tv_nsec += 1000000000;
-        finished.tv_sec--;
+        fprintf(stderr, "Out of memory.\n");
+        return -1;
     }
-    sec = finished.tv_sec + finished.tv_nsec * 1e-9;
-    printf("%u %sB / %.3f msec (%.1f MiB/s = %.1f MB/s)\n",
-        (unsigned) (size >= 0x00100000 ? (size >> 20) : size >= 0x00000400 ? (size >> 10) : size),
-        size >= 0x00100000 ? "Mi" : size >= 0x00000400 ? "Ki" : "",
-        sec * 1000, size/sec/0x00100000, size/sec/1000000);
-    return 0;
-}
+    job->file = file;
+    job->base = base;
+    job->wordsize = abswordsize; /* snapshot is already in host byte order */
+    job->bytes = bytes;
+    job->linesize = linesize;
+    job->group = group;
+    job->ascii = ascii;
 
-int memcomp(const volatile void* source, const volatile void* dest, size_t size, int wordsize)
+    /* one tight burst of device accesses */
+    vec.ptr = ptr;
+    vec.wordsize = wordsize;
+    vec.count = bytes / abswordsize;
+    vec.data = job->data.bytes;
+    if (memreadv(&vec, 1) != 0)
+    {
+        free(job);
+        fprintf(file, "<aborted>\n");
+        return -1;
+    }
+
+    /* Other files may be closed as soon as we return (e.g. iocsh redirects),
+       thus write them synchronously. */
+    if ((file != stdout && file != stderr) || asyncInit() != 0)
+    {
+        int len = displayMemory(file, base, job->data.bytes, abswordsize, bytes, linesize, group, ascii, 0);
+        free(job);
+        return len;
+    }
+
+    epicsMutexMustLock(async.lock);
+    while (async.head - async.tail == ASYNC_SLOTS ||
+        (async.head != async.tail && async.queuedBytes + bytes > ASYNC_BYTES))
+    {
+        /* ring full: wait for the writer */
+        epicsMutexUnlock(async.lock);
+        epicsEventMustWait(async.spaceAvailable);
+        epicsMutexMustLock(async.lock);
+    }
+    async.ring[async.head % ASYNC_SLOTS] = job;
+    async.head++;
+    async.queuedBytes += bytes;
+    epicsMutexUnlock(async.lock);
+    epicsEventSignal(async.jobAvailable);
+    return 0;
+}
+
+void memDisplayAsyncWait(void)
+{
+    if (asyncInit() != 0) return;
+    epicsMutexMustLock(async.lock);
+    while (async.head != async.tail)
+    {
+        epicsMutexUnlock(async.lock);
+        epicsEventMustWait(async.idle);
+        epicsMutexMustLock(async.lock);
+    }
+    epicsMutexUnlock(async.lock);
+}
+
+static int readWords(memReadVector* v)
+{
+    size_t i;
+
+    if (v->count == 0) return 0;
+    switch (v->wordsize)
+    {
+        case 1:
+        case -1:
+            for (i = 0; i < v->count; i++)
+                ((uint8_t*)v->data)[i] = ((const volatile uint8_t*)v->ptr)[i];
+            break;
+        case 2:
+            for (i = 0; i < v->count; i++)
+                ((uint16_t*)v->data)[i] = ((const volatile uint16_t*)v->ptr)[i];
+            break;
+        case 4:
+            for (i = 0; i < v->count; i++)
+                ((uint32_t*)v->data)[i] = ((const volatile uint32_t*)v->ptr)[i];
+            break;
+        case 8:
+            for (i = 0; i < v->count; i++)
+                ((uint64_t*)v->data)[i] = ((const volatile uint64_t*)v->ptr)[i];
+            break;
+        case -2:
+            for (i = 0; i < v->count; i++)
+            {
+                uint16_t x = ((const volatile uint16_t*)v->ptr)[i];
+                ((uint16_t*)v->data)[i] = bswap_16(x);
+            }
+            break;
+        case -4:
+            for (i = 0; i < v->count; i++)
+            {
+                uint32_t x = ((const volatile uint32_t*)v->ptr)[i];
+                ((uint32_t*)v->data)[i] = bswap_32(x);
+            }
+            break;
+        case -8:
+            for (i = 0; i < v->count; i++)
+            {
+                uint64_t x = ((const volatile uint64_t*)v->ptr)[i];
+                ((uint64_t*)v->data)[i] = bswap_64(x);
+            }
+            break;
+        default:
+            fprintf(stderr, "Illegal wordsize %d: must be 1, 2, 4, 8, -2, -4, -8\n", v->wordsize);
+            return -1;
+    }
+    return 0;
+}
+
+int memreadv(memReadVector* vec, size_t n)
+{
+    /* modified after sigsetjmp, thus volatile */
+    volatile size_t i = 0;
+    volatile int failed = 0;
+
+    while (i < n)
+    {
+        if (catchSignals())
+        {
+            /* skip the faulting entry and re-arm for the rest */
+            vec[i].status = -1;
+            failed++;
+            i++;
+            continue;
+        }
+        for (; i < n; i++)
+        {
+            vec[i].status = readWords(&vec[i]);
+            if (vec[i].status) failed++;
+        }
+        signalsOff();
+    }
+    return failed;
+}
+
+static int foreignEndian(unsigned int caps)
+{
+    const union { uint16_t u; uint8_t c[2]; } host = { 1 };
+
+    return (caps & (host.c[0] ? MEMDISPLAY_BIG_ENDIAN : MEMDISPLAY_LITTLE_ENDIAN)) != 0;
+}
+
+int memDisplayAutoWordsize(unsigned int caps, unsigned int caps2)
+{
+    unsigned int widths =
+        (caps & MEMDISPLAY_WIDTHS ? caps & MEMDISPLAY_WIDTHS : MEMDISPLAY_WIDTHS) &
+        (caps2 & MEMDISPLAY_WIDTHS ? caps2 & MEMDISPLAY_WIDTHS : MEMDISPLAY_WIDTHS);
+    int swap = foreignEndian(caps) != foreignEndian(caps2);
+    int wordsize;
+
+    if (!widths) return -1;
+    /* plain memory on both sides: let libc choose */
+    if (!swap && caps & caps2 & MEMDISPLAY_RAM) return 0;
+    /* nothing known about one side and no restriction from the other:
+       keep the default of the function */
+    if (!swap && (!caps || !caps2) && !((caps | caps2) & MEMDISPLAY_WIDTHS)) return 0;
+    for (wordsize = 8; !(widths & wordsize); wordsize >>= 1);
+    return swap && wordsize > 1 ? -wordsize : wordsize;
+}
+
+int memfill(volatile void* address, int pattern, size_t size, int wordsize, int increment)
+{
+    size_t i;
+    int abswordsize;
+
+    if (!wordsize) {
+        if (pattern & 0xffff0000) wordsize=4;
+        else if (pattern & 0xff00) wordsize=2;
+        else wordsize=1;
+    }
+    abswordsize = abs(wordsize);
+
+    if (catchSignals()) return -1;
+    for (i = 0; i < size/abswordsize; i++)
+    {
+        switch (wordsize)
+        {
+            case 0:
+            case 1:
+            case -1:
+                ((volatile uint8_t*)address)[i] = pattern;
+                break;
+            case 2:
+                ((volatile uint16_t*)address)[i] = pattern;
+                break;
+            case 4:
+                ((volatile uint32_t*)address)[i] = pattern;
+                break;
+            case -2:
+                ((volatile uint16_t*)address)[i] = bswap_16(pattern);
+                break;
+            case -4:
+                ((volatile uint32_t*)address)[i] = bswap_32(pattern);
+                break;
+            default:
+                fprintf(stderr, "Illegal wordsize %d: must be 1, 2, 4, -2, -4\n", wordsize);
+                signalsOff();
+                return -1;
+        }
+        pattern += increment;
+    }
+    signalsOff();
+    return 0;
+}
+
+static int copyWords(const volatile void* source, volatile void* dest, size_t size, int wordsize)
+{
+    size_t i;
+
+    switch (wordsize)
+    {
+        case 0:
+            memcpy((void*)dest, (const void*)source, size);
+            break;
+        case 1:
+        case -1:
+            for (i = 0; i < size; i++)
+                ((volatile uint8_t*)dest)[i] = ((const volatile uint8_t*)source)[i];
+            break;
+        case 2:
+            for (i = 0; i < size/2; i++)
+                ((volatile uint16_t*)dest)[i] = ((const volatile uint16_t*)source)[i];
+            break;
+        case 4:
+            for (i = 0; i < size/4; i++)
+                ((volatile uint32_t*)dest)[i] = ((const volatile uint32_t*)source)[i];
+            break;
+        case 8:
+            for (i = 0; i < size/8; i++)
+                ((volatile uint64_t*)dest)[i] = ((const volatile uint64_t*)source)[i];
+            break;
+        case -2:
+            for (i = 0; i < size/2; i++)
+                ((volatile uint16_t*)dest)[i] = bswap_16(((const volatile uint16_t*)source)[i]);
+            break;
+        case -4:
+            for (i = 0; i < size/4; i++)
+                ((volatile uint32_t*)dest)[i] = bswap_32(((const volatile uint32_t*)source)[i]);
+            break;
+        case -8:
+            for (i = 0; i < size/8; i++)
+                ((volatile uint64_t*)dest)[i] = bswap_64(((const volatile uint64_t*)source)[i]);
+            break;
+        default:
+            fprintf(stderr, "Illegal wordsize %d: must be 1, 2, 4, 8, -2, -4, -8\n", wordsize);
+            return -1;
+    }
+    return 0;
+}
+
+static double elapsed(const struct timespec* start, const struct timespec* finished)
+{
+    time_t sec = finished->tv_sec - start->tv_sec;
+    long nsec = finished->tv_nsec - start->tv_nsec;
+    if (nsec < 0)
+    {
+        nsec += 1000000000;
+        sec--;
+    }
+    return sec + nsec * 1e-9;
+}
+
+static char* rateToStr(size_t size, double sec, char* str)
+{
+    sprintf(str, "%u %sB / %.3f msec (%.1f MiB/s = %.1f MB/s)",
+        (unsigned) (size >= 0x00100000 ? (size >> 20) : size >= 0x00000400 ? (size >> 10) : size),
+        size >= 0x00100000 ? "Mi" : size >= 0x00000400 ? "Ki" : "",
+        sec * 1000, size/sec/0x00100000, size/sec/1000000);
+    return str;
+}
+
+static void printRate(size_t size, double sec)
+{
+    char b[80];
+    printf("%s\n", rateToStr(size, sec, b));
+}
+
+int memcopy(const volatile void* source, volatile void* dest, size_t size, int wordsize)
+{
+    struct timespec start, finished;
+    int status;
+
+    if (catchSignals()) return -1;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    status = copyWords(source, dest, size, wordsize);
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    signalsOff();
+    if (status != 0) return -1;
+    printRate(size, elapsed(&start, &finished));
+    return 0;
+}
+
+/* Parse a list of CPUs like "0-3,8,10-11".
+   Items "nodeN" stand for all CPUs of NUMA node N (Linux only). */
+static int parseCpuList(const char* cpus, int* list, int max)
+{
+    const char* p = cpus;
+    char* q;
+    int n = 0;
+
+    while (p && *p)
+    {
+        long first, last;
+        if (strncmp(p, "node", 4) == 0)
+        {
+#ifdef __linux
+            char filename[64];
+            char nodecpus[1024];
+            FILE* file;
+            int node = strtol(p+4, &q, 10);
+            sprintf(filename, "/sys/devices/system/node/node%d/cpulist", node);
+            file = fopen(filename, "r");
+            if (!file || !fgets(nodecpus, sizeof(nodecpus), file))
+            {
+                fprintf(stderr, "Cannot read CPUs of NUMA node %d\n", node);
+                if (file) fclose(file);
+                return -1;
+            }
+            fclose(file);
+            nodecpus[strcspn(nodecpus, "\n")] = 0;
+            first = parseCpuList(nodecpus, list + n, max - n);
+            if (first < 0) return -1;
+            n += first;
+#else
+            fprintf(stderr, "NUMA nodes not supported on this system\n");
+            return -1;
+#endif
+        }
+        else
+        {
+            first = last = strtol(p, &q, 10);
+            if (q == p)
+            {
+                fprintf(stderr, "Invalid CPU list %s\n", cpus);
+                return -1;
+            }
+            if (*q == '-')
+                last = strtol(q+1, &q, 10);
+            for (; first <= last && n < max; first++)
+                list[n++] = first;
+        }
+        if (*q != 0 && *q != ',')
+        {
+            fprintf(stderr, "Invalid CPU list %s\n", cpus);
+            return -1;
+        }
+        p = *q ? q+1 : q;
+    }
+    return n;
+}
+
+#define MAX_THREADS 256
+
+struct worker {
+    int (*run)(void* arg);
+    void* arg;
+    int cpu;
+    int status;
+    double sec;
+    epicsEventId go;
+    epicsEventId done;
+};
+
+static void pinThread(int cpu)
+{
+#ifdef __linux
+    cpu_set_t set;
+
+    if (cpu < 0) return;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    /* pid 0 is the calling thread */
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        fprintf(stderr, "Pinning thread to CPU %d failed: %s\n", cpu, strerror(errno));
+#else
+    if (cpu >= 0)
+        fprintf(stderr, "Pinning threads not supported on this system\n");
+#endif
+}
+
+static void workerThread(void* arg)
+{
+    struct worker* w = arg;
+    struct timespec start, finished;
+
+    pinThread(w->cpu);
+    epicsEventSignal(w->done);
+    epicsEventMustWait(w->go);
+    if (catchSignalsInThread())
+    {
+        releaseSignalsInThread();
+        w->status = -1;
+        epicsEventSignal(w->done);
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    w->status = w->run ? w->run(w->arg) : 0;
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    releaseSignalsInThread();
+    w->sec = elapsed(&start, &finished);
+    epicsEventSignal(w->done);
+}
+
+/* Run all workers concurrently, starting them together.
+   A single unpinned worker runs in the calling thread.
+   Returns the wall clock time or -1 if threads could not be created. */
+static double runWorkers(struct worker* workers, int n, const char* name)
+{
+    int i, started, failed = 0;
+    struct timespec start, finished;
+
+    if (n == 1 && workers->cpu < 0)
+    {
+        if (catchSignals())
+        {
+            workers->status = -1;
+            return 0;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        workers->status = workers->run(workers->arg);
+        clock_gettime(CLOCK_MONOTONIC, &finished);
+        signalsOff();
+        return workers->sec = elapsed(&start, &finished);
+    }
+
+    signalsOn();
+    for (started = 0; started < n; started++)
+    {
+        struct worker* w = &workers[started];
+        char threadname[32];
+
+        w->go = epicsEventCreate(epicsEventEmpty);
+        w->done = epicsEventCreate(epicsEventEmpty);
+        sprintf(threadname, "%.20s%d", name, started);
+        if (!w->go || !w->done || !epicsThreadCreate(threadname, epicsThreadPriorityMedium,
+            epicsThreadGetStackSize(epicsThreadStackMedium), workerThread, w))
+        {
+            fprintf(stderr, "Creating thread %s failed\n", threadname);
+            if (w->go) epicsEventDestroy(w->go);
+            if (w->done) epicsEventDestroy(w->done);
+            failed = 1;
+            break;
+        }
+    }
+    /* wait until all threads are ready, then start them together */
+    for (i = 0; i < started; i++)
+        epicsEventMustWait(workers[i].done);
+    if (failed)
+    {
+        /* let the started threads terminate without doing anything */
+        for (i = 0; i < started; i++)
+            workers[i].run = NULL;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < started; i++)
+        epicsEventSignal(workers[i].go);
+    for (i = 0; i < started; i++)
+        epicsEventMustWait(workers[i].done);
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    signalsOff();
+    for (i = 0; i < started; i++)
+    {
+        epicsEventDestroy(workers[i].go);
+        epicsEventDestroy(workers[i].done);
+    }
+    if (failed) return -1;
+    return elapsed(&start, &finished);
+}
+
+static int numCPUs(void)
+{
+#ifdef HAVE_epicsThreadGetCPUs
+    return epicsThreadGetCPUs();
+#else
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0) return n;
+#endif
+    return 1;
+#endif
+}
+
+/* Copy and verify in pieces small enough to be still in cache when read back */
+#define VERIFY_CHUNK 0x4000
+
+struct verifyResult {
+    unsigned long long mismatches;
+    size_t first;
+    unsigned long long expected;
+    unsigned long long actual;
+};
+
+#define VERIFY_LOOP(type, swap) \
+    for (i = 0; i < size / sizeof(type); i++) \
+    { \
+        type s = ((const volatile type*)source)[i]; \
+        type d = ((const volatile type*)dest)[i]; \
+        s = (type)swap(s); \
+        if (s != d && r->mismatches++ == 0) \
+        { \
+            r->first = offs + i * sizeof(type); \
+            r->expected = s; \
+            r->actual = d; \
+        } \
+    }
+
+static void verifyWords(const volatile void* source, const volatile void* dest, size_t size, int wordsize,
+    size_t offs, struct verifyResult* r)
+{
+    size_t i;
+
+    switch (wordsize)
+    {
+        case 0:
+            if (memcmp((const void*)source, (const void*)dest, size) == 0)
+                break;
+            /* fall through */
+        case 1:
+        case -1:
+            VERIFY_LOOP(uint8_t, noswap);
+            break;
+        case 2:
+            VERIFY_LOOP(uint16_t, noswap);
+            break;
+        case 4:
+            VERIFY_LOOP(uint32_t, noswap);
+            break;
+        case 8:
+            VERIFY_LOOP(uint64_t, noswap);
+            break;
+        case -2:
+            VERIFY_LOOP(uint16_t, bswap_16);
+            break;
+        case -4:
+            VERIFY_LOOP(uint32_t, bswap_32);
+            break;
+        case -8:
+            VERIFY_LOOP(uint64_t, bswap_64);
+            break;
+    }
+}
+
+static int copyVerifyWords(const volatile char* source, volatile char* dest, size_t size, int wordsize,
+    struct verifyResult* r)
+{
+    size_t offs, len;
+
+    for (offs = 0; offs < size; offs += len)
+    {
+        len = size - offs < VERIFY_CHUNK ? size - offs : VERIFY_CHUNK;
+        if (copyWords(source + offs, dest + offs, len, wordsize) != 0)
+            return -1;
+        verifyWords(source + offs, dest + offs, len, wordsize, offs, r);
+    }
+    return 0;
+}
+
+struct copyChunk {
+    const volatile char* source;
+    volatile char* dest;
+    size_t size;
+    int wordsize;
+    int verify;
+    struct verifyResult result;
+};
+
+static int copyChunkRun(void* arg)
+{
+    struct copyChunk* c = arg;
+    if (c->verify)
+        return copyVerifyWords(c->source, c->dest, c->size, c->wordsize, &c->result);
+    return copyWords(c->source, c->dest, c->size, c->wordsize);
+}
+
+static int copyParallel(const volatile void* source, volatile void* dest, size_t size, int wordsize,
+    int threads, const char* cpus, int verify)
+{
+    struct worker* workers;
+    struct copyChunk* chunks;
+    struct verifyResult* first = NULL;
+    unsigned long long mismatches = 0;
+    int cpulist[MAX_THREADS];
+    int ncpus = 0, i, status = 0, perThread;
+    size_t chunk, offs = 0;
+    double sec;
+
+    switch (wordsize)
+    {
+        case 0:
+        case 1:
+        case 2:
+        case 4:
+        case 8:
+        case -1:
+        case -2:
+        case -4:
+        case -8:
+            break;
+        default:
+            fprintf(stderr, "Illegal wordsize %d: must be 1, 2, 4, 8, -2, -4, -8\n", wordsize);
+            return -1;
+    }
+    if (cpus && (ncpus = parseCpuList(cpus, cpulist, MAX_THREADS)) < 0)
+        return -1;
+    if (threads <= 0) threads = ncpus;
+    if (threads <= 0) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+    /* split in cache line aligned chunks */
+    chunk = (size / threads) & ~(size_t)63;
+    if (chunk == 0)
+    {
+        threads = 1;
+        chunk = size;
+    }
+
+    workers = calloc(threads, sizeof(struct worker));
+    chunks = calloc(threads, sizeof(struct copyChunk));
+    if (!workers || !chunks)
+    {
+        free(workers);
+        free(chunks);
+        fprintf(stderr, "Out of memory.\n");
+        return -1;
+    }
+    for (i = 0; i < threads; i++)
+    {
+        chunks[i].source = (const volatile char*)source + offs;
+        chunks[i].dest = (volatile char*)dest + offs;
+        chunks[i].size = i == threads-1 ? size - offs : chunk;
+        chunks[i].wordsize = wordsize;
+        chunks[i].verify = verify;
+        offs += chunks[i].size;
+        workers[i].run = copyChunkRun;
+        workers[i].arg = &chunks[i];
+        workers[i].cpu = ncpus ? cpulist[i % ncpus] : -1;
+    }
+    sec = runWorkers(workers, threads, "memcopy");
+    if (sec < 0) status = -1;
+    /* a single verified copy is reported like memcopy */
+    perThread = threads > 1 || cpus || !verify;
+    for (i = 0; i < threads && status == 0 && perThread; i++)
+    {
+        printf("thread %d", i);
+        if (workers[i].cpu >= 0) printf(" cpu %d", workers[i].cpu);
+        printf(": ");
+        if (workers[i].status == 0)
+            printRate(chunks[i].size, workers[i].sec);
+        else
+            printf("<aborted>\n");
+    }
+    for (i = 0; i < threads; i++)
+    {
+        if (workers[i].status != 0) status = -1;
+        if (chunks[i].result.mismatches && !first)
+        {
+            first = &chunks[i].result;
+            first->first += chunks[i].source - (const volatile char*)source;
+        }
+        mismatches += chunks[i].result.mismatches;
+    }
+    if (status == 0)
+    {
+        if (perThread) printf("total: ");
+        printRate(size, sec);
+    }
+    else if (!perThread)
+        printf("<aborted>\n");
+    if (status == 0 && verify)
+    {
+        if (first)
+            printf("%llu mismatches, first at offset %#llx: 0x%0*llx != 0x%0*llx\n",
+                mismatches, (unsigned long long)first->first,
+                wordsize ? abs(wordsize)*2 : 2, first->expected,
+                wordsize ? abs(wordsize)*2 : 2, first->actual);
+        else
+            printf("verify OK\n");
+    }
+    free(workers);
+    free(chunks);
+    if (status != 0) return -1;
+    return mismatches != 0;
+}
+
+int memcopyParallel(const volatile void* source, volatile void* dest, size_t size, int wordsize,
+    int threads, const char* cpus)
+{
+    return copyParallel(source, dest, size, wordsize, threads, cpus, 0);
+}
+
+int memcopyVerify(const volatile void* source, volatile void* dest, size_t size, int wordsize,
+    int threads, const char* cpus)
+{
+    return copyParallel(source, dest, size, wordsize, threads, cpus, 1);
+}
+
+int memcomp(const volatile void* source, const volatile void* dest, size_t size, int wordsize)
 {
     size_t i;
     int abswordsize = abs(wordsize);
@@ -451,6 +1453,460 @@ int memcomp(const volatile void* source, const volatile void* dest, size_t size,
     return 0;
 }
 
+int memcompRAM(const volatile void* source, const volatile void* dest, size_t size)
+{
+    int status;
+
+    if (catchSignals()) return -1;
+    status = memcmp((const void*)source, (const void*)dest, size);
+    signalsOff();
+    if (status == 0)
+    {
+        printf("OK\n");
+        return 0;
+    }
+    /* find the first mismatch */
+    return memcomp(source, dest, size, 1);
+}
+
+/* Bit error rate */
+
+#ifdef __GNUC__
+#define popcount64(x) __builtin_popcountll(x)
+#define ctz64(x) __builtin_ctzll(x)
+#else
+static int popcount64(uint64_t x)
+{
+    int n = 0;
+    for (; x; x &= x - 1) n++;
+    return n;
+}
+
+static int ctz64(uint64_t x)
+{
+    int n = 0;
+    for (; !(x & 1); x >>= 1) n++;
+    return n;
+}
+#endif
+
+struct berStats {
+    unsigned long long errors;
+    unsigned long long bits[64];    /* errors per bit position */
+    unsigned long long words[65];   /* words with n bit errors */
+};
+
+static void berCount(struct berStats* st, uint64_t x)
+{
+    int n = popcount64(x);
+    st->errors += n;
+    st->words[n]++;
+    for (; x; x &= x - 1)
+        st->bits[ctz64(x)]++;
+}
+
+/* plain memory: copy blocks of words into locals, which works for any
+   alignment, check them for any difference first, which the compiler
+   can vectorize, and only count bits in blocks with errors */
+#define BER_BLOCK 8
+
+static void berCompareBlock(struct berStats* st, const uint64_t* s, const uint64_t* d, size_t n)
+{
+    uint64_t any = 0;
+    size_t k;
+
+    for (k = 0; k < n; k++)
+        any |= s[k] ^ d[k];
+    if (!any) return;
+    for (k = 0; k < n; k++)
+        if (s[k] != d[k]) berCount(st, s[k] ^ d[k]);
+}
+
+/* size in bytes, a partial last word is padded with zeros on both sides */
+static void berCompareMem(struct berStats* st, const char* s, const char* d, size_t size)
+{
+    uint64_t sw[BER_BLOCK], dw[BER_BLOCK];
+    size_t i;
+
+    for (i = 0; i + sizeof(sw) <= size; i += sizeof(sw))
+    {
+        memcpy(sw, s + i, sizeof(sw));
+        memcpy(dw, d + i, sizeof(dw));
+        berCompareBlock(st, sw, dw, BER_BLOCK);
+    }
+    if (i < size)
+    {
+        memset(sw, 0, sizeof(sw));
+        memset(dw, 0, sizeof(dw));
+        memcpy(sw, s + i, size - i);
+        memcpy(dw, d + i, size - i);
+        berCompareBlock(st, sw, dw, (size - i + 7) / 8);
+    }
+}
+
+#define BER_LOOP(type, swap) \
+    for (i = 0; i < size / sizeof(type); i++) \
+    { \
+        type x = ((const volatile type*)source)[i]; \
+        x = (type)swap(x) ^ ((const volatile type*)dest)[i]; \
+        if (x) berCount(st, x); \
+    }
+
+static int berPass(struct berStats* st, const volatile void* source, const volatile void* dest, size_t size, int wordsize)
+{
+    size_t i;
+
+    if (catchSignals()) return -1;
+    switch (wordsize)
+    {
+        case 0:
+            berCompareMem(st, (const char*)source, (const char*)dest, size);
+            break;
+        case 1:
+        case -1:
+            BER_LOOP(uint8_t, noswap);
+            break;
+        case 2:
+            BER_LOOP(uint16_t, noswap);
+            break;
+        case 4:
+            BER_LOOP(uint32_t, noswap);
+            break;
+        case 8:
+            BER_LOOP(uint64_t, noswap);
+            break;
+        case -2:
+            BER_LOOP(uint16_t, bswap_16);
+            break;
+        case -4:
+            BER_LOOP(uint32_t, bswap_32);
+            break;
+        case -8:
+            BER_LOOP(uint64_t, bswap_64);
+            break;
+    }
+    signalsOff();
+    return 0;
+}
+
+int memcompBER(const volatile void* source, const volatile void* dest, size_t size, int wordsize, int repeat)
+{
+    struct berStats st;
+    struct timespec start, finished;
+    int bytes = wordsize ? abs(wordsize) : 8;
+    unsigned long long words, bits, differ = 0;
+    int pass, k, status = 0;
+    char b[80];
+
+    switch (wordsize)
+    {
+        case 0:
+        case 1:
+        case 2:
+        case 4:
+        case 8:
+        case -1:
+        case -2:
+        case -4:
+        case -8:
+            break;
+        default:
+            fprintf(stderr, "Illegal wordsize %d: must be 1, 2, 4, 8, -2, -4, -8\n", wordsize);
+            return -1;
+    }
+    if (repeat <= 0) repeat = 1;
+    /* words are accessed whole, only plain memory compares a partial last word */
+    if (wordsize)
+        size &= ~(size_t)(bytes - 1);
+    memset(&st, 0, sizeof(st));
+
+    for (pass = 1; pass <= repeat; pass++)
+    {
+        unsigned long long errors = st.errors;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        status = berPass(&st, source, dest, size, wordsize);
+        clock_gettime(CLOCK_MONOTONIC, &finished);
+        if (status != 0)
+        {
+            printf("pass %d aborted\n", pass);
+            break;
+        }
+        printf("pass %d: %llu bit errors, BER %.3g, %s\n", pass, st.errors - errors,
+            size ? (st.errors - errors) / (size * 8.0) : 0.0, rateToStr(size, elapsed(&start, &finished), b));
+    }
+
+    words = (unsigned long long)(pass - 1) * ((size + bytes - 1) / bytes);
+    bits = (unsigned long long)(pass - 1) * size * 8;
+    for (k = 1; k <= bytes * 8; k++)
+        differ += st.words[k];
+    printf("total: %llu bit errors in %llu bits, BER %.3g, %llu of %llu words differ\n",
+        st.errors, bits, bits ? st.errors / (double)bits : 0.0, differ, words);
+    if (st.errors)
+    {
+        printf("errors per bit:");
+        for (k = 0; k < bytes * 8; k++)
+        {
+            if (!st.bits[k]) continue;
+            printf(" %d:%llu", k, st.bits[k]);
+        }
+        printf("\nwords with n bit errors:");
+        for (k = 1; k <= bytes * 8; k++)
+        {
+            if (!st.words[k]) continue;
+            printf(" %d:%llu", k, st.words[k]);
+        }
+        printf("\n");
+    }
+    if (status != 0) return -1;
+    return st.errors != 0;
+}
+
+/* Memory test */
+
+enum { PATTERN_WALK1, PATTERN_WALK0, PATTERN_ADDR, PATTERN_CHECK, PATTERN_RANDOM, PATTERN_COUNT };
+static const char* patternNames[PATTERN_COUNT] = { "walk1", "walk0", "addr", "check", "random" };
+
+#define MAX_REPORTED_ERRORS 16
+
+struct testChunk {
+    volatile char* address;
+    size_t offset;          /* of the chunk in the tested region */
+    size_t size;
+    int wordsize;
+    int pattern;
+    int pass;
+    int verify;
+    size_t errors;
+    uint64_t failbits;
+    struct {
+        size_t offset;
+        uint64_t expected;
+        uint64_t actual;
+    } error[MAX_REPORTED_ERRORS];
+};
+
+static uint64_t splitmix64(uint64_t x)
+{
+    x += UINT64_C(0x9e3779b97f4a7c15);
+    x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+    return x ^ (x >> 31);
+}
+
+/* i is the word index in the tested region */
+static uint64_t testValue(const struct testChunk* c, size_t i, uint64_t* state)
+{
+    int bits = c->wordsize * 8;
+
+    switch (c->pattern)
+    {
+        case PATTERN_WALK1:
+            return UINT64_C(1) << ((i + c->pass) % bits);
+        case PATTERN_WALK0:
+            return ~(UINT64_C(1) << ((i + c->pass) % bits));
+        case PATTERN_ADDR:
+            return (i * c->wordsize) ^ (c->pass & 1 ? ~UINT64_C(0) : 0);
+        case PATTERN_CHECK:
+            return (i + c->pass) & 1 ? UINT64_C(0xaaaaaaaaaaaaaaaa) : UINT64_C(0x5555555555555555);
+        default:
+            /* xorshift LFSR, seeded per chunk so that chunks can run in parallel */
+            *state ^= *state << 13;
+            *state ^= *state >> 7;
+            *state ^= *state << 17;
+            return *state;
+    }
+}
+
+static int testChunkRun(void* arg)
+{
+    struct testChunk* c = arg;
+    size_t k, n = c->size / c->wordsize;
+    size_t first = c->offset / c->wordsize;
+    uint64_t state = splitmix64(((uint64_t)c->pass << 48) ^ c->offset) | 1;
+
+#define TEST_LOOP(type) \
+    for (k = 0; k < n; k++) \
+    { \
+        type x = (type)testValue(c, first + k, &state); \
+        if (!c->verify) \
+            ((volatile type*)c->address)[k] = x; \
+        else \
+        { \
+            type y = ((volatile type*)c->address)[k]; \
+            if (y != x) \
+            { \
+                if (c->errors < MAX_REPORTED_ERRORS) \
+                { \
+                    c->error[c->errors].offset = c->offset + k * sizeof(type); \
+                    c->error[c->errors].expected = x; \
+                    c->error[c->errors].actual = y; \
+                } \
+                c->errors++; \
+                c->failbits |= x ^ y; \
+            } \
+        } \
+    }
+
+    switch (c->wordsize)
+    {
+        case 1:
+            TEST_LOOP(uint8_t)
+            break;
+        case 2:
+            TEST_LOOP(uint16_t)
+            break;
+        case 4:
+            TEST_LOOP(uint32_t)
+            break;
+        case 8:
+            TEST_LOOP(uint64_t)
+            break;
+    }
+#undef TEST_LOOP
+    return 0;
+}
+
+int memtest(size_t base, volatile void* address, size_t size, int wordsize, const char* patterns, int passes, int threads)
+{
+    struct worker* workers;
+    struct testChunk* chunks;
+    int selected[PATTERN_COUNT];
+    int npatterns = 0, pass, i, j;
+    size_t chunk, offs, errors = 0;
+    uint64_t failbits = 0;
+    const char *p = patterns;
+
+    wordsize = abs(wordsize);
+    if (wordsize == 0) wordsize = 4;
+    switch (wordsize)
+    {
+        case 1:
+        case 2:
+        case 4:
+        case 8:
+            break;
+        default:
+            fprintf(stderr, "Illegal wordsize %d: must be 1, 2, 4, 8\n", wordsize);
+            return -1;
+    }
+    while (p && *p)
+    {
+        size_t len = strcspn(p, ",");
+        for (i = 0; i < PATTERN_COUNT; i++)
+            if (strncmp(p, patternNames[i], len) == 0 && patternNames[i][len] == 0) break;
+        if (i == PATTERN_COUNT)
+        {
+            fprintf(stderr, "Unknown pattern %.*s: must be walk1, walk0, addr, check, random\n", (int)len, p);
+            return -1;
+        }
+        if (npatterns < PATTERN_COUNT)
+            selected[npatterns++] = i;
+        p += len;
+        if (*p) p++;
+    }
+    if (npatterns == 0)
+        for (npatterns = 0; npatterns < PATTERN_COUNT; npatterns++)
+            selected[npatterns] = npatterns;
+    if (passes <= 0) passes = 1;
+    if (threads <= 0) threads = numCPUs();
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    size &= ~(size_t)(wordsize-1);
+
+    /* split in cache line aligned chunks */
+    chunk = (size / threads) & ~(size_t)63;
+    if (chunk == 0)
+    {
+        threads = 1;
+        chunk = size;
+    }
+
+    workers = calloc(threads, sizeof(struct worker));
+    chunks = calloc(threads, sizeof(struct testChunk));
+    if (!workers || !chunks)
+    {
+        free(workers);
+        free(chunks);
+        fprintf(stderr, "Out of memory.\n");
+        return -1;
+    }
+    for (pass = 0; pass < passes; pass++)
+    {
+        for (j = 0; j < npatterns; j++)
+        {
+            double sec[2];
+            size_t patternErrors = 0;
+            char b[2][80];
+            int verify;
+
+            for (verify = 0; verify < 2; verify++)
+            {
+                for (i = 0, offs = 0; i < threads; i++)
+                {
+                    struct testChunk* c = &chunks[i];
+                    memset(c, 0, sizeof(struct testChunk));
+                    c->address = (volatile char*)address + offs;
+                    c->offset = offs;
+                    c->size = i == threads-1 ? size - offs : chunk;
+                    c->wordsize = wordsize;
+                    c->pattern = selected[j];
+                    c->pass = pass;
+                    c->verify = verify;
+                    offs += c->size;
+                    workers[i].run = testChunkRun;
+                    workers[i].arg = c;
+                    workers[i].cpu = -1;
+                    workers[i].status = 0;
+                }
+                sec[verify] = runWorkers(workers, threads, "memtest");
+                for (i = 0; i < threads; i++)
+                {
+                    if (sec[verify] < 0 || workers[i].status != 0)
+                    {
+                        printf("pass %d %s: <aborted>\n", pass+1, patternNames[selected[j]]);
+                        free(workers);
+                        free(chunks);
+                        return -1;
+                    }
+                }
+            }
+            for (i = 0; i < threads; i++)
+                patternErrors += chunks[i].errors;
+            printf("pass %d %-6s fill %s verify %s: %llu errors\n",
+                pass+1, patternNames[selected[j]],
+                rateToStr(size, sec[0], b[0]), rateToStr(size, sec[1], b[1]),
+                (unsigned long long)patternErrors);
+            for (i = 0; i < threads; i++)
+            {
+                struct testChunk* c = &chunks[i];
+                size_t k;
+                for (k = 0; k < c->errors && k < MAX_REPORTED_ERRORS; k++)
+                    printf("  %#llx: wrote 0x%0*llx read 0x%0*llx failing bits 0x%0*llx\n",
+                        (unsigned long long)(base + c->error[k].offset),
+                        wordsize*2, (unsigned long long)c->error[k].expected,
+                        wordsize*2, (unsigned long long)c->error[k].actual,
+                        wordsize*2, (unsigned long long)(c->error[k].expected ^ c->error[k].actual));
+                if (c->errors > MAX_REPORTED_ERRORS)
+                    printf("  ... %llu more errors in %#llx-%#llx\n",
+                        (unsigned long long)(c->errors - MAX_REPORTED_ERRORS),
+                        (unsigned long long)(base + c->offset), (unsigned long long)(base + c->offset + c->size - 1));
+                failbits |= c->failbits;
+            }
+            errors += patternErrors;
+        }
+    }
+    free(workers);
+    free(chunks);
+    if (errors)
+    {
+        printf("%llu errors, failing bits 0x%0*llx\n",
+            (unsigned long long)errors, wordsize*2, (unsigned long long)failbits);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
+
 unsigned long long strToSize(const char* str, char** endptr)
 {
     char* p = (char*)str, *q;
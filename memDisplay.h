@@ -14,12 +14,38 @@ epicsShareExtern int memDisplayDebug;
 epicsShareFunc int memDisplay(size_t base, volatile void* ptr, int wordsize, size_t bytes);
 epicsShareFunc int fmemDisplay(FILE* outfile, size_t base, volatile void* ptr, int wordsize, size_t bytes);
 #define memDisplay(base, ptr, wordsize, bytes) fmemDisplay(stdout, base, ptr, wordsize, bytes)
+epicsShareFunc int fmemDisplayFormat(FILE* outfile, size_t base, volatile void* ptr, int wordsize, size_t bytes,
+    int linesize, int group, int ascii);
+
+epicsShareExtern int memDisplayAsync;
+epicsShareFunc int fmemDisplayAsync(FILE* outfile, size_t base, volatile void* ptr, int wordsize, size_t bytes);
+epicsShareFunc int fmemDisplayAsyncFormat(FILE* outfile, size_t base, volatile void* ptr, int wordsize, size_t bytes,
+    int linesize, int group, int ascii);
+epicsShareFunc void memDisplayAsyncWait(void);
 
 typedef volatile void* (*memDisplayAddrHandler) (size_t addr, size_t size, size_t usr);
 epicsShareFunc void memDisplayInstallAddrHandler(const char* str, memDisplayAddrHandler handler, size_t usr);
 
+/* Capabilities of an address space */
+#define MEMDISPLAY_WIDTH1        0x01 /* allowed access widths, none set: any */
+#define MEMDISPLAY_WIDTH2        0x02
+#define MEMDISPLAY_WIDTH4        0x04
+#define MEMDISPLAY_WIDTH8        0x08
+#define MEMDISPLAY_WIDTHS        0x0f
+#define MEMDISPLAY_BIG_ENDIAN    0x10 /* native byte order of the bus */
+#define MEMDISPLAY_LITTLE_ENDIAN 0x20
+#define MEMDISPLAY_BURST         0x40 /* prefetchable, reads have no side effects */
+#define MEMDISPLAY_RAM           0x80 /* plain memory, libc functions may be used */
+epicsShareFunc void memDisplayInstallAddrHandlerCaps(const char* str, memDisplayAddrHandler handler, size_t usr,
+    unsigned int caps);
+epicsShareFunc unsigned int memDisplayAddrCaps(const char* addrstr);
+epicsShareFunc int memDisplayAutoWordsize(unsigned int caps, unsigned int caps2);
+
+/* returned by a translator which recognizes an address but cannot translate it */
+#define MEMDISPLAY_ADDR_REJECTED ((volatile void*)~(size_t)0)
 typedef volatile void* (*memDisplayAddrTranslator) (const char* addr, size_t offs, size_t size);
 epicsShareFunc void memDisplayInstallAddrTranslator(memDisplayAddrTranslator handler);
+epicsShareFunc void memDisplayInstallAddrTranslatorCaps(memDisplayAddrTranslator handler, unsigned int caps);
 
 epicsShareFunc unsigned long long strToSize(const char* str, char** endptr);
 epicsShareFunc char* sizeToStr(unsigned long long size, char* str);
@@ -27,7 +53,44 @@ epicsShareFunc volatile void* strToPtr(const char* addrstr, size_t size);
 
 epicsShareFunc int memfill(volatile void* address, int pattern, size_t size, int wordsize, int increment);
 epicsShareFunc int memcopy(const volatile void* source, volatile void* dest, size_t size, int wordsize);
+epicsShareFunc int memcopyParallel(const volatile void* source, volatile void* dest, size_t size, int wordsize,
+    int threads, const char* cpus);
+epicsShareFunc int memcopyVerify(const volatile void* source, volatile void* dest, size_t size, int wordsize,
+    int threads, const char* cpus);
 epicsShareFunc int memcomp(const volatile void* source, const volatile void* dest, size_t size, int wordsize);
+epicsShareFunc int memcompBER(const volatile void* source, const volatile void* dest, size_t size, int wordsize,
+    int repeat);
+epicsShareFunc int memtest(size_t base, volatile void* address, size_t size, int wordsize, const char* patterns, int passes, int threads);
+
+epicsShareFunc int memsnap(const char* name, size_t base, const volatile void* ptr, size_t size, int wordsize);
+epicsShareFunc int memdiff(const char* name, size_t base, const volatile void* ptr, int wordsize);
+epicsShareFunc int memdiffSnap(const char* name, const char* other);
+epicsShareFunc int memsnapSave(const char* name, const char* filename);
+epicsShareFunc int memsnapLoad(const char* name, const char* filename);
+epicsShareFunc int memsnapFree(const char* name);
+epicsShareFunc size_t memsnapSize(const char* name);
+epicsShareFunc void memsnapList(void);
+
+typedef struct {
+    const volatile void* ptr; /* source address */
+    int wordsize;             /* 1, 2, 4, 8 or negative for byte swap */
+    size_t count;             /* number of words */
+    void* data;               /* destination, receives words in host byte order */
+    int status;               /* set to -1 if the access failed */
+} memReadVector;
+epicsShareFunc int memreadv(memReadVector* vec, size_t n);
+
+typedef struct {
+    const char* address;      /* [addrspace:]address */
+    int wordsize;             /* 1, 2, 4, 8 or negative for byte swap */
+    size_t count;             /* number of words */
+} memDisplayBatchItem;
+epicsShareFunc int fmemDisplayBatch(FILE* outfile, const memDisplayBatchItem* items, size_t n);
+#define memDisplayBatch(items, n) fmemDisplayBatch(stdout, items, n)
+
+epicsShareFunc volatile void* memDisplayBufferAlloc(const char* name, size_t size, const char* options);
+epicsShareFunc int memDisplayBufferFree(const char* name);
+epicsShareFunc volatile void* memDisplayBufferFind(const char* name, size_t* size);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,28 @@
+#ifndef memDisplayPriv_h
+#define memDisplayPriv_h
+
+/* Interfaces shared between the source files of memDisplay, not installed */
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* display words which have already been read into a buffer in host byte order */
+int memDisplayFormatData(FILE* outfile, size_t base, const void* data, int wordsize, size_t bytes);
+
+/* memcomp of plain memory on both sides with memcmp */
+int memcompRAM(const volatile void* source, const volatile void* dest, size_t size);
+
+/* Called with the siginfo_t and ucontext_t of SIGSEGV or SIGBUS before
+   memDisplay treats an access as failed. Returns 0 if the fault has been
+   handled and the access can be retried, else the signal to report. */
+typedef int (*memDisplayFaultFilter) (int sig, void* info, void* context);
+void memDisplayInstallFaultFilter(memDisplayFaultFilter filter);
+int memDisplayFilterFault(int sig, void* info, void* context);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,499 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <memoryapi.h>
+#define valloc(size) VirtualAlloc(NULL, size, MEM_COMMIT, PAGE_READWRITE)
+#define vfree(ptr) VirtualFree(ptr, 0, MEM_RELEASE)
+#else
+#define vfree(ptr) free(ptr)
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+
+#ifdef __unix
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#ifdef __linux
+#include <sys/syscall.h>
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#endif
+#ifndef MPOL_F_NODE
+#define MPOL_F_NODE (1<<0)
+#define MPOL_F_ADDR (1<<1)
+#endif
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#endif
+
+#include <epicsString.h>
+#include <epicsStdioRedirect.h>
+#include <envDefs.h>
+#include <iocsh.h>
+
+#ifdef vxWorks
+#include <memLib.h>
+#endif
+
+#include "epicsExport.h"
+#include "memDisplay.h"
+
+#define BUFFER_HUGE     1   /* transparent huge pages */
+#define BUFFER_HUGETLB  2   /* explicit huge pages */
+#define BUFFER_PREFAULT 4   /* touch all pages after allocation */
+#define BUFFER_LOCK     8   /* lock pages in memory */
+#define BUFFER_MMAP    16   /* allocated with mmap, release with munmap */
+
+struct bufferItem {
+    char* name;
+    char* ptr;
+    size_t size;
+    void* raw;              /* what to release */
+    size_t rawsize;
+    size_t align;
+    size_t pagesize;
+    int flags;
+    int node;
+    struct bufferItem* next;
+} *bufferList = NULL;
+
+static unsigned int bufferCount = 0;
+
+static size_t systemPageSize(void)
+{
+#ifdef __unix
+    long pagesize = sysconf(_SC_PAGESIZE);
+    if (pagesize > 0) return pagesize;
+#endif
+    return 4096;
+}
+
+static struct bufferItem* bufferFind(const char* name, size_t len)
+{
+    struct bufferItem* item;
+
+    for (item = bufferList; item != NULL; item = item->next)
+    {
+        if (strncmp(item->name, name, len) == 0 && item->name[len] == 0)
+            return item;
+    }
+    return NULL;
+}
+
+/* options: align=<size>,huge,hugetlb[=<pagesize>],node=<n>,prefault,lock */
+static int bufferParseOptions(struct bufferItem* item, const char* options)
+{
+    const char *p = options;
+    char *q;
+
+    item->node = -1;
+    while (p && *p)
+    {
+        size_t len = strcspn(p, ",= ");
+        if (strncmp(p, "align", len) == 0 && len == 5 && p[len] == '=')
+        {
+            item->align = strToSize(p+len+1, &q);
+            if (item->align & (item->align-1))
+            {
+                fprintf(stderr, "Alignment must be a power of 2.\n");
+                return -1;
+            }
+        }
+        else if (strncmp(p, "huge", len) == 0 && len == 4)
+        {
+            item->flags |= BUFFER_HUGE;
+            q = (char*)p+len;
+        }
+        else if (strncmp(p, "hugetlb", len) == 0 && len == 7)
+        {
+            item->flags |= BUFFER_HUGETLB;
+            q = (char*)p+len;
+            if (*q == '=')
+                item->pagesize = strToSize(q+1, &q);
+            if (item->pagesize & (item->pagesize-1))
+            {
+                fprintf(stderr, "Huge page size must be a power of 2.\n");
+                return -1;
+            }
+        }
+        else if (strncmp(p, "node", len) == 0 && len == 4 && p[len] == '=')
+        {
+            item->node = strtol(p+len+1, &q, 0);
+        }
+        else if (strncmp(p, "prefault", len) == 0 && len == 8)
+        {
+            item->flags |= BUFFER_PREFAULT;
+            q = (char*)p+len;
+        }
+        else if (strncmp(p, "lock", len) == 0 && len == 4)
+        {
+            item->flags |= BUFFER_LOCK;
+            q = (char*)p+len;
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %.*s\n", (int)len, p);
+            return -1;
+        }
+        if (*q != 0 && *q != ',')
+        {
+            fprintf(stderr, "Invalid option %s\n", p);
+            return -1;
+        }
+        p = *q ? q+1 : q;
+    }
+    return 0;
+}
+
+static int bufferAllocate(struct bufferItem* item)
+{
+    size_t pagesize = systemPageSize();
+
+#ifdef __linux
+    int mapflags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+    if (item->flags & BUFFER_HUGETLB)
+    {
+        int shift = 0;
+        if (item->pagesize)
+        {
+            while ((1UL << shift) < item->pagesize) shift++;
+            mapflags |= shift << MAP_HUGE_SHIFT;
+        }
+        else
+            item->pagesize = 2 << 20;
+        mapflags |= MAP_HUGETLB;
+        pagesize = item->pagesize;
+    }
+    else
+    {
+        if ((item->flags & BUFFER_HUGE) && item->align < 2 << 20)
+            item->align = 2 << 20;
+        item->pagesize = pagesize;
+    }
+    if (item->align < pagesize)
+        item->align = pagesize;
+    /* full pages, at least one */
+    item->size = item->size ? (item->size + pagesize - 1) & ~(pagesize - 1) : pagesize;
+
+    /* over-allocate and trim to get the alignment */
+    item->rawsize = item->size + item->align - pagesize;
+    item->raw = mmap(NULL, item->rawsize, PROT_READ | PROT_WRITE, mapflags, -1, 0);
+    if (item->raw == MAP_FAILED)
+    {
+        item->raw = NULL;
+        fprintf(stderr, "mmap failed: %s\n", strerror(errno));
+        return -1;
+    }
+    item->flags |= BUFFER_MMAP;
+    item->ptr = (char*)(((size_t)item->raw + item->align - 1) & ~(item->align - 1));
+    if (item->ptr > (char*)item->raw)
+        munmap(item->raw, item->ptr - (char*)item->raw);
+    if (item->ptr + item->size < (char*)item->raw + item->rawsize)
+        munmap(item->ptr + item->size, (char*)item->raw + item->rawsize - (item->ptr + item->size));
+    item->raw = item->ptr;
+    item->rawsize = item->size;
+
+    if ((item->flags & BUFFER_HUGE) && madvise(item->ptr, item->size, MADV_HUGEPAGE) != 0)
+        fprintf(stderr, "madvise MADV_HUGEPAGE failed: %s\n", strerror(errno));
+
+    if (item->node >= 0)
+    {
+        unsigned long nodemask[4] = {0};
+        if (item->node >= (int)sizeof(nodemask)*8)
+        {
+            fprintf(stderr, "NUMA node %d too large.\n", item->node);
+            return -1;
+        }
+        nodemask[item->node / (sizeof(long)*8)] = 1UL << (item->node % (sizeof(long)*8));
+        if (syscall(SYS_mbind, item->ptr, item->size, MPOL_BIND, nodemask, sizeof(nodemask)*8, 0) != 0)
+        {
+            fprintf(stderr, "Binding to NUMA node %d failed: %s\n", item->node, strerror(errno));
+            return -1;
+        }
+    }
+#else
+    if (item->flags & (BUFFER_HUGE | BUFFER_HUGETLB))
+        fprintf(stderr, "Huge pages not supported on this system. Ignored.\n");
+    if (item->node >= 0)
+        fprintf(stderr, "NUMA binding not supported on this system. Ignored.\n");
+    item->pagesize = pagesize;
+    if (!item->size) item->size = pagesize;
+    if (item->align <= pagesize)
+    {
+        item->align = pagesize;
+        item->rawsize = item->size;
+        item->raw = valloc(item->size);
+        item->ptr = item->raw;
+    }
+    else
+    {
+        /* over-allocate to get the alignment */
+        item->rawsize = item->size + item->align;
+        item->raw = malloc(item->rawsize);
+        item->ptr = (char*)(((size_t)item->raw + item->align - 1) & ~(item->align - 1));
+    }
+    if (!item->raw)
+    {
+        fprintf(stderr, "Out of memory.\n");
+        return -1;
+    }
+#endif
+
+    if (item->flags & BUFFER_PREFAULT)
+    {
+        /* first touch in this thread, after NUMA binding */
+        volatile char* p;
+        for (p = item->ptr; p < item->ptr + item->size; p += pagesize)
+            *p = 0;
+    }
+
+    if (item->flags & BUFFER_LOCK)
+    {
+#ifdef __unix
+        if (mlock(item->ptr, item->size) != 0)
+            fprintf(stderr, "mlock failed: %s\n", strerror(errno));
+#else
+        fprintf(stderr, "Locking not supported on this system. Ignored.\n");
+#endif
+    }
+    return 0;
+}
+
+static void bufferRelease(struct bufferItem* item)
+{
+#ifdef __unix
+    if (item->flags & BUFFER_MMAP)
+        munmap(item->raw, item->rawsize);
+    else
+#endif
+    if (item->align > item->pagesize)
+        free(item->raw);
+    else
+        vfree(item->raw);
+    free(item->name);
+    free(item);
+}
+
+volatile void* memDisplayBufferAlloc(const char* name, size_t size, const char* options)
+{
+    struct bufferItem* item;
+    char autoname[20];
+
+    if (!name)
+    {
+        do sprintf(autoname, "buf%u", bufferCount++);
+        while (bufferFind(autoname, strlen(autoname)));
+        name = autoname;
+    }
+    if (strchr(name, ':'))
+    {
+        fprintf(stderr, "Buffer name %s must not contain ':'.\n", name);
+        return NULL;
+    }
+    if (bufferFind(name, strlen(name)))
+    {
+        fprintf(stderr, "Buffer %s already exists.\n", name);
+        return NULL;
+    }
+    item = calloc(1, sizeof(struct bufferItem));
+    if (!item)
+    {
+        fprintf(stderr, "Out of memory.\n");
+        return NULL;
+    }
+    item->size = size;
+    if (bufferParseOptions(item, options) != 0 || bufferAllocate(item) != 0)
+    {
+        if (item->raw) bufferRelease(item);
+        else free(item);
+        return NULL;
+    }
+    item->name = epicsStrDup(name);
+    item->next = bufferList;
+    bufferList = item;
+    return item->ptr;
+}
+
+int memDisplayBufferFree(const char* name)
+{
+    struct bufferItem** pitem;
+
+    for (pitem = &bufferList; *pitem != NULL; pitem = &(*pitem)->next)
+    {
+        if (strcmp((*pitem)->name, name) == 0)
+        {
+            struct bufferItem* item = *pitem;
+            *pitem = item->next;
+            bufferRelease(item);
+            return 0;
+        }
+    }
+    fprintf(stderr, "Unknown buffer %s\n", name);
+    return -1;
+}
+
+volatile void* memDisplayBufferFind(const char* name, size_t* size)
+{
+    struct bufferItem* item = bufferFind(name, strlen(name));
+
+    if (!item) return NULL;
+    if (size) *size = item->size;
+    return item->ptr;
+}
+
+static void bufferShow(struct bufferItem* item, int details)
+{
+    char b[80];
+
+    printf("%-12s %p %s", item->name, item->ptr, sizeToStr(item->size, b));
+    if (details)
+    {
+        printf("\n  align %s", sizeToStr(item->align, b));
+        printf("\n  page size %s%s", sizeToStr(item->pagesize, b),
+            item->flags & BUFFER_HUGETLB ? " (hugetlb)" :
+            item->flags & BUFFER_HUGE ? " (transparent huge pages)" : "");
+#ifdef __linux
+        if (item->node >= 0 || (item->flags & BUFFER_PREFAULT))
+        {
+            int node = -1;
+            if (syscall(SYS_get_mempolicy, &node, NULL, 0, item->ptr, MPOL_F_NODE | MPOL_F_ADDR) == 0)
+                printf("\n  NUMA node %d", node);
+            if (item->node >= 0)
+                printf(" (bound to %d)", item->node);
+        }
+#endif
+        if (item->flags & BUFFER_PREFAULT) printf("\n  prefaulted");
+        if (item->flags & BUFFER_LOCK) printf("\n  locked");
+    }
+    printf("\n");
+}
+
+static volatile void* bufferTranslator(const char* addr, size_t offs, size_t size)
+{
+    struct bufferItem* item;
+    const char *name, *p;
+    unsigned long long offset = 0;
+    char *q;
+
+    if (strncmp(addr, "buf:", 4) != 0) return NULL;
+    name = addr + 4;
+    p = strchr(name, ':');
+    item = bufferFind(name, p ? (size_t)(p - name) : strlen(name));
+    if (!item)
+    {
+        fprintf(stderr, "Unknown buffer %.*s\n", p ? (int)(p - name) : (int)strlen(name), name);
+        return MEMDISPLAY_ADDR_REJECTED;
+    }
+    if (p)
+    {
+        offset = strToSize(p+1, &q);
+        if (*q != 0)
+        {
+            fprintf(stderr, "Invalid address %s.\n", addr);
+            return MEMDISPLAY_ADDR_REJECTED;
+        }
+    }
+    offset += offs;
+    if (offset > item->size || size > item->size - offset)
+    {
+        fprintf(stderr, "Address %s + 0x%llx size 0x%llx exceeds buffer %s size 0x%llx.\n",
+            addr, (unsigned long long)offs, (unsigned long long)size,
+            item->name, (unsigned long long)item->size);
+        return MEMDISPLAY_ADDR_REJECTED;
+    }
+    return item->ptr + offset;
+}
+
+static const iocshFuncDef mallocDef =
+    { "malloc", 3, (const iocshArg *[]) {
+    &(iocshArg) { "size", iocshArgString },
+    &(iocshArg) { "[name]", iocshArgString },
+    &(iocshArg) { "[align=size,huge,hugetlb[=pagesize],node=n,prefault,lock]", iocshArgString },
+}};
+
+static void mallocFunc(const iocshArgBuf *args)
+{
+    volatile void *p;
+    char b[20];
+
+    if (!args[0].sval)
+    {
+        iocshCmd("help malloc");
+        return;
+    }
+    p = memDisplayBufferAlloc(args[1].sval, strToSize(args[0].sval, NULL), args[2].sval);
+    if (!p) return;
+    sprintf(b, "%p", p);
+    epicsEnvSet("BUFFER", b);
+    printf("BUFFER = %s = buf:%s\n", b, bufferList->name);
+}
+
+static const iocshFuncDef bufferFreeDef =
+    { "bufferFree", 1, (const iocshArg *[]) {
+    &(iocshArg) { "name", iocshArgString },
+}};
+
+static void bufferFreeFunc(const iocshArgBuf *args)
+{
+    if (!args[0].sval)
+    {
+        iocshCmd("help bufferFree");
+        return;
+    }
+    memDisplayBufferFree(args[0].sval);
+}
+
+static const iocshFuncDef bufferListDef =
+    { "bufferList", 0, NULL };
+
+static void bufferListFunc(const iocshArgBuf *args)
+{
+    struct bufferItem* item;
+
+    (void)args;
+    for (item = bufferList; item != NULL; item = item->next)
+        bufferShow(item, 0);
+}
+
+static const iocshFuncDef bufferInfoDef =
+    { "bufferInfo", 1, (const iocshArg *[]) {
+    &(iocshArg) { "name", iocshArgString },
+}};
+
+static void bufferInfoFunc(const iocshArgBuf *args)
+{
+    struct bufferItem* item;
+
+    if (!args[0].sval)
+    {
+        iocshCmd("help bufferInfo");
+        return;
+    }
+    item = bufferFind(args[0].sval, strlen(args[0].sval));
+    if (!item)
+    {
+        fprintf(stderr, "Unknown buffer %s\n", args[0].sval);
+        return;
+    }
+    bufferShow(item, 1);
+}
+
+static void memDisplayBufferRegistrar(void)
+{
+    memDisplayInstallAddrTranslatorCaps(bufferTranslator, MEMDISPLAY_RAM);
+    iocshRegister(&mallocDef, mallocFunc);
+    iocshRegister(&bufferFreeDef, bufferFreeFunc);
+    iocshRegister(&bufferListDef, bufferListFunc);
+    iocshRegister(&bufferInfoDef, bufferInfoFunc);
+}
+epicsExportRegistrar(memDisplayBufferRegistrar);
@@ -1,9 +1,3 @@
-#ifdef _WIN32
-#include <Windows.h>
-#include <memoryapi.h>
-#define valloc(size) VirtualAlloc(NULL, size, MEM_COMMIT, PAGE_READWRITE)
-#endif
-
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -22,15 +16,23 @@
 
 #include "epicsExport.h"
 #include "memDisplay.h"
+#include "memDisplayPriv.h"
 
 struct addressHandlerItem {
     const char* name;
     memDisplayAddrHandler handler;
     size_t usr;
+    unsigned int caps;
     struct addressHandlerItem* next;
 } *addressHandlerList = NULL;
 
 void memDisplayInstallAddrHandler(const char* name, memDisplayAddrHandler handler, size_t usr)
+{
+    memDisplayInstallAddrHandlerCaps(name, handler, usr, 0);
+}
+
+void memDisplayInstallAddrHandlerCaps(const char* name, memDisplayAddrHandler handler, size_t usr,
+    unsigned int caps)
 {
     char *s;
     struct addressHandlerItem* item =
@@ -50,16 +52,23 @@ void memDisplayInstallAddrHandler(const char* name, memDisplayAddrHandler handle
     item->name = s;
     item->handler = handler;
     item->usr = usr;
+    item->caps = caps;
     item->next = addressHandlerList;
     addressHandlerList = item;
 }
 
 struct addressTranslatorItem {
     memDisplayAddrTranslator translator;
+    unsigned int caps;
     struct addressTranslatorItem* next;
 } *addressTranslatorList = NULL;
 
 void memDisplayInstallAddrTranslator(memDisplayAddrTranslator translator)
+{
+    memDisplayInstallAddrTranslatorCaps(translator, 0);
+}
+
+void memDisplayInstallAddrTranslatorCaps(memDisplayAddrTranslator translator, unsigned int caps)
 {
     struct addressTranslatorItem* item =
         (struct addressTranslatorItem*) malloc(sizeof(struct addressTranslatorItem));
@@ -69,21 +78,20 @@ void memDisplayInstallAddrTranslator(memDisplayAddrTranslator translator)
         return;
     }
     item->translator = translator;
+    item->caps = caps;
     item->next = addressTranslatorList;
     addressTranslatorList = item;
 }
 
-typedef struct {volatile void* ptr; size_t offs;} remote_addr_t;
-static remote_addr_t strToAddr(const char* addrstr, size_t offs, size_t size)
+/* *pinvalid is set if the address space is known but the address is not parsable */
+static struct addressHandlerItem* findAddrHandler(const char* addrstr, unsigned long long* paddr, int* pinvalid)
 {
     unsigned long long addr = 0;
     size_t len;
-    volatile char* ptr = NULL;
     struct addressHandlerItem* hitem;
-    struct addressTranslatorItem* titem;
-    char *p, *q;
-    char c;
+    char *q;
 
+    *pinvalid = 0;
     for (hitem = addressHandlerList; hitem != NULL; hitem = hitem->next)
     {
         len = strlen(hitem->name);
@@ -92,33 +100,72 @@ static remote_addr_t strToAddr(const char* addrstr, size_t offs, size_t size)
         {
             if (addrstr[len])
             {
-                addr = strToSize(addrstr+len+1, &q) + offs;
+                addr = strToSize(addrstr+len+1, &q);
                 if (*q != 0)
                 {
                     /* rubbish at end */
                     fprintf(stderr, "Invalid address %s.\n", addrstr);
-                    return (remote_addr_t){NULL, 0};
-                }
-                if (addr & ~(unsigned long long)((size_t)-1))
-                {
-                    fprintf(stderr, "Too large address %s for %u bit.\n", addrstr, (int) sizeof(void*)*8);
-                    return (remote_addr_t){NULL, 0};
+                    *pinvalid = 1;
                 }
             }
-            errno = 0;
-            ptr = hitem->handler(addr, size, hitem->usr);
-            if (!ptr)
-            {
-                if (errno)
-                    fprintf(stderr, "Getting address 0x%llx in %s address space failed: %s\n",
-                        addr, hitem->name, strerror(errno));
-                else
-                    fprintf(stderr, "Getting address 0x%llx in %s address space failed.\n",
-                        addr, hitem->name);
-            }
-            return (remote_addr_t){ptr, addr};
+            *paddr = addr;
+            return hitem;
         }
     }
+    return NULL;
+}
+
+static volatile void* mapAddrHandler(struct addressHandlerItem* hitem, unsigned long long addr, size_t size)
+{
+    volatile void* ptr;
+
+    if (addr & ~(unsigned long long)((size_t)-1))
+    {
+        fprintf(stderr, "Too large address 0x%llx for %u bit.\n", addr, (int) sizeof(void*)*8);
+        return NULL;
+    }
+    errno = 0;
+    ptr = hitem->handler(addr, size, hitem->usr);
+    if (!ptr)
+    {
+        if (errno)
+            fprintf(stderr, "Getting address 0x%llx in %s address space failed: %s\n",
+                addr, hitem->name, strerror(errno));
+        else
+            fprintf(stderr, "Getting address 0x%llx in %s address space failed.\n",
+                addr, hitem->name);
+    }
+    return ptr;
+}
+
+unsigned int memDisplayAddrCaps(const char* addrstr)
+{
+    unsigned long long addr;
+    int invalid;
+    struct addressHandlerItem* hitem = findAddrHandler(addrstr, &addr, &invalid);
+
+    return hitem ? hitem->caps : 0;
+}
+
+typedef struct {volatile void* ptr; size_t offs; unsigned int caps;} remote_addr_t;
+static remote_addr_t strToAddr(const char* addrstr, size_t offs, size_t size)
+{
+    unsigned long long addr = 0;
+    volatile char* ptr = NULL;
+    struct addressHandlerItem* hitem;
+    struct addressTranslatorItem* titem;
+    char *p, *q;
+    char c;
+    int invalid;
+
+    if ((hitem = findAddrHandler(addrstr, &addr, &invalid)) != NULL)
+    {
+        if (invalid)
+            return (remote_addr_t){NULL, 0, 0};
+        addr += offs;
+        ptr = mapAddrHandler(hitem, addr, size);
+        return (remote_addr_t){ptr, addr, hitem->caps};
+    }
     for (titem = addressTranslatorList; titem != NULL; titem = titem->next)
     {
         if ((p = strrchr((char*)addrstr, ':')) != NULL)
@@ -126,18 +173,20 @@ static remote_addr_t strToAddr(const char* addrstr, size_t offs, size_t size)
             addr = strToSize(p+1, &q);
         }
         ptr = titem->translator(addrstr, offs, size);
-        if (ptr) return (remote_addr_t){ptr, addr + offs};
+        /* the translator has recognized but rejected the address */
+        if (ptr == MEMDISPLAY_ADDR_REJECTED) return (remote_addr_t){NULL, 0, 0};
+        if (ptr) return (remote_addr_t){ptr, addr + offs, titem->caps};
     }
 
     /* no addrspace */
     if (!addr && (ptr = epicsFindSymbol(addrstr)) != NULL)
     {
         /* global variable name */
-        return (remote_addr_t){ptr + offs, (size_t)ptr + offs};
+        return (remote_addr_t){ptr + offs, (size_t)ptr + offs, 0};
     }
     if (sscanf(addrstr, "%p%c", &ptr, &c) == 1) {
         ptr += offs;
-        return (remote_addr_t){ptr + offs, (size_t)ptr + offs};
+        return (remote_addr_t){ptr + offs, (size_t)ptr + offs, 0};
     }
     addr = strToSize(addrstr, &q) + offs;
     if (q > addrstr)
@@ -147,17 +196,17 @@ static remote_addr_t strToAddr(const char* addrstr, size_t offs, size_t size)
         {
             /* rubbish at end */
             fprintf(stderr, "Unparsable address %s\n", addrstr);
-            return (remote_addr_t){NULL, 0};
+            return (remote_addr_t){NULL, 0, 0};
         }
         if (addr & ~(unsigned long long)((size_t)-1))
         {
             fprintf(stderr, "Too large address %s for %u bit.\n", addrstr, (int) sizeof(void*)*8);
-            return (remote_addr_t){NULL, 0};
+            return (remote_addr_t){NULL, 0, 0};
         }
-        return (remote_addr_t){(void*)(size_t) addr, addr};
+        return (remote_addr_t){(void*)(size_t) addr, addr, 0};
     }
     fprintf(stderr, "Unknown address %s\n", addrstr);
-    return (remote_addr_t){NULL, 0};
+    return (remote_addr_t){NULL, 0, 0};
 }
 
 volatile void* strToPtr(const char* addrStr, size_t size)
@@ -166,37 +215,244 @@ volatile void* strToPtr(const char* addrStr, size_t size)
     return addr.ptr;
 }
 
-void md(const char* addrStr, int wordsize, int bytes)
+/* Batch entries in the same address space are mapped together
+   as long as they fit into the same window of this size. */
+#define BATCH_WINDOW 0x1000
+
+typedef struct {
+    struct addressHandlerItem* hitem;
+    unsigned long long addr;
+    size_t bytes;
+    size_t index;
+} batchEntry;
+
+static int batchEntryCmp(const void* a, const void* b)
+{
+    const batchEntry* x = a;
+    const batchEntry* y = b;
+
+    if (x->hitem != y->hitem) return x->hitem < y->hitem ? -1 : 1;
+    if (x->addr != y->addr) return x->addr < y->addr ? -1 : 1;
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+int fmemDisplayBatch(FILE* file, const memDisplayBatchItem* items, size_t n)
+{
+    batchEntry* entries;
+    memReadVector* vec;
+    struct {
+        struct addressHandlerItem* hitem;
+        size_t offs;
+        int wordsize;
+        enum { BATCH_UNMAPPED, BATCH_MAPPED, BATCH_INVALID } state;
+    } *info;
+    char* buffer = NULL;
+    size_t i, j, k, total = 0, nentries = 0;
+    struct addressHandlerItem* space = NULL;
+    int len = 0;
+
+    entries = calloc(n, sizeof(batchEntry));
+    vec = calloc(n, sizeof(memReadVector));
+    info = calloc(n, sizeof(*info));
+    if (n && (!entries || !vec || !info))
+    {
+        fprintf(stderr, "Out of memory.\n");
+        len = -1;
+        goto end;
+    }
+
+    /* parse addresses, reserve space in the result buffer */
+    for (i = 0; i < n; i++)
+    {
+        int wordsize = items[i].wordsize;
+        int abswordsize;
+        unsigned long long addr;
+        int invalid;
+
+        info[i].hitem = findAddrHandler(items[i].address, &addr, &invalid);
+        if (wordsize == 0)
+            wordsize = memDisplayAutoWordsize(info[i].hitem ? info[i].hitem->caps : 0, MEMDISPLAY_RAM);
+        if (wordsize == 0)
+            wordsize = 2;
+        info[i].wordsize = wordsize;
+        abswordsize = abs(wordsize);
+        switch (abswordsize)
+        {
+            case 1:
+            case 2:
+            case 4:
+            case 8:
+                break;
+            default:
+                info[i].state = BATCH_INVALID;
+                continue;
+        }
+        vec[i].wordsize = wordsize;
+        total = (total + 7) & ~(size_t)7;
+        vec[i].data = (void*)total;
+        total += items[i].count * abswordsize;
+
+        if (info[i].hitem)
+        {
+            if (invalid) continue;
+            /* align start to wordsize */
+            entries[nentries].hitem = info[i].hitem;
+            entries[nentries].addr = addr & ~(unsigned long long)(abswordsize-1);
+            entries[nentries].bytes = items[i].count * abswordsize;
+            entries[nentries].index = i;
+            nentries++;
+        }
+        else
+        {
+            remote_addr_t addr = strToAddr(items[i].address, 0, items[i].count * abswordsize);
+            if (!addr.ptr) continue;
+            vec[i].ptr = (volatile char*)addr.ptr - (addr.offs & (abswordsize-1));
+            info[i].offs = addr.offs & ~(size_t)(abswordsize-1);
+            info[i].state = BATCH_MAPPED;
+        }
+    }
+
+    /* map entries in the same address space and window with one handler call */
+    qsort(entries, nentries, sizeof(batchEntry), batchEntryCmp);
+    for (j = 0; j < nentries; j = k)
+    {
+        unsigned long long start = entries[j].addr;
+        unsigned long long end = start + entries[j].bytes;
+        unsigned long long window = (start & ~(unsigned long long)(BATCH_WINDOW-1)) + BATCH_WINDOW;
+        volatile char* ptr;
+
+        for (k = j+1; k < nentries &&
+            entries[k].hitem == entries[j].hitem &&
+            entries[k].addr + entries[k].bytes <= window; k++)
+        {
+            if (entries[k].addr + entries[k].bytes > end)
+                end = entries[k].addr + entries[k].bytes;
+        }
+        if (memDisplayDebug)
+            fprintf(stderr, "memDisplayBatch: mapping %s:0x%llx size 0x%llx for %u entries\n",
+                entries[j].hitem->name, start, end - start, (unsigned)(k - j));
+        ptr = mapAddrHandler(entries[j].hitem, start, end - start);
+        if (!ptr) continue;
+        for (; j < k; j++)
+        {
+            i = entries[j].index;
+            vec[i].ptr = ptr + (entries[j].addr - start);
+            info[i].offs = entries[j].addr;
+            info[i].state = BATCH_MAPPED;
+        }
+    }
+
+    /* read everything in one go */
+    buffer = malloc(total ? total : 1);
+    if (!buffer)
+    {
+        fprintf(stderr, "Out of memory.\n");
+        len = -1;
+        goto end;
+    }
+    for (i = 0; i < n; i++)
+    {
+        vec[i].data = buffer + (size_t)vec[i].data;
+        if (info[i].state == BATCH_MAPPED)
+            vec[i].count = items[i].count;
+    }
+    memreadv(vec, n);
+
+    /* format everything in one go */
+    for (i = 0; i < n; i++)
+    {
+        if (info[i].hitem != space)
+        {
+            space = info[i].hitem;
+            if (space) len += fprintf(file, "%s:\n", space->name);
+        }
+        if (info[i].state == BATCH_INVALID)
+        {
+            len += fprintf(file, "%s: <invalid wordsize %d>\n", items[i].address, info[i].wordsize);
+            continue;
+        }
+        if (info[i].state == BATCH_UNMAPPED)
+        {
+            len += fprintf(file, "%s: <unmapped>\n", items[i].address);
+            continue;
+        }
+        if (vec[i].status != 0)
+        {
+            len += fprintf(file, "%s: <aborted>\n", items[i].address);
+            continue;
+        }
+        if (vec[i].count == 0) continue;
+        /* items outside of address spaces are not grouped, show their address */
+        if (!info[i].hitem)
+            len += fprintf(file, "%s:\n", items[i].address);
+        /* the data is already in host byte order */
+        len += memDisplayFormatData(file, info[i].offs, vec[i].data, abs(vec[i].wordsize),
+            vec[i].count * abs(vec[i].wordsize));
+    }
+end:
+    free(buffer);
+    free(entries);
+    free(vec);
+    free(info);
+    return len;
+}
+
+void md(const char* addrStr, int wordsize, int bytes, int linesize, int group, const char* ascii)
 {
     remote_addr_t addr;
     static remote_addr_t old_addr = {0};
     static int old_wordsize = 2;
     static int old_bytes = 0x80;
+    static int old_linesize = 16;
+    static int old_group = 0;
+    static int old_ascii = 1;
     static char* old_addrStr;
     static size_t old_offs;
+    int showAscii = old_ascii;
 
     if ((!addrStr && !old_addr.ptr) || (addrStr && addrStr[0] == '?'))
     {
-        printf("md \"[addrspace:]address\", [wordsize={1|2|4|8|-2|-4|-8}], [bytes]\n");
+        printf("md \"[addrspace:]address\", [wordsize={1|2|4|8|-2|-4|-8}], [bytes], "
+            "[linesize], [group], [\"ascii\"|\"noascii\"]\n");
         return;
     }
+    if (ascii && ascii[0])
+    {
+        if (strcmp(ascii, "ascii") == 0)
+            showAscii = 1;
+        else if (strcmp(ascii, "noascii") == 0)
+            showAscii = 0;
+        else
+        {
+            printf("Invalid ascii option %s: must be ascii or noascii\n", ascii);
+            return;
+        }
+    }
     if (addrStr)
     {
         free(old_addrStr);
         old_addrStr = epicsStrDup(addrStr);
         old_offs = 0;
-        old_wordsize = 2;
+        old_wordsize = 0;
     }
     else
     {
         addrStr = old_addrStr;
     }
     if (bytes == 0) bytes = old_bytes;
-    if (wordsize == 0) wordsize = old_wordsize;
     addr = strToAddr(addrStr, old_offs, bytes);
     if (!addr.ptr)
         return;
-    if (memDisplay(addr.offs, addr.ptr, wordsize, bytes) < 0)
+    if (wordsize == 0) wordsize = old_wordsize;
+    if (wordsize == 0) wordsize = memDisplayAutoWordsize(addr.caps, MEMDISPLAY_RAM);
+    if (wordsize == 0) wordsize = 2;
+    if (linesize == 0) linesize = old_linesize;
+    /* keep the previous grouping if it fits wordsize and line size */
+    if (group == 0 && old_group && old_group % abs(wordsize) == 0 && linesize % old_group == 0)
+        group = old_group;
+    if ((memDisplayAsync ?
+        fmemDisplayAsyncFormat(stdout, addr.offs, addr.ptr, wordsize, bytes, linesize, group, showAscii) :
+        fmemDisplayFormat(stdout, addr.offs, addr.ptr, wordsize, bytes, linesize, group, showAscii)) < 0)
     {
         old_addr = (remote_addr_t){0};
         return;
@@ -204,35 +460,104 @@ void md(const char* addrStr, int wordsize, int bytes)
     old_offs += bytes;
     old_wordsize = wordsize;
     old_bytes = bytes;
+    old_linesize = linesize;
+    old_group = group;
+    old_ascii = showAscii;
     old_addr = addr;
 }
 
 epicsExportAddress(int, memDisplayDebug);
+epicsExportAddress(int, memDisplayAsync);
 
 static const iocshArg mdArg0 = { "[addrspace:]address", iocshArgString };
 static const iocshArg mdArg1 = { "[wordsize={1|2|4|8|-2|-4|-8}]", iocshArgInt };
 static const iocshArg mdArg2 = { "[bytes]", iocshArgInt };
-static const iocshArg *mdArgs[] = {&mdArg0, &mdArg1, &mdArg2};
-static const iocshFuncDef mdDef = { "md", 3, mdArgs };
+static const iocshArg mdArg3 = { "[linesize]", iocshArgInt };
+static const iocshArg mdArg4 = { "[group]", iocshArgInt };
+static const iocshArg mdArg5 = { "[ascii|noascii]", iocshArgString };
+static const iocshArg *mdArgs[] = {&mdArg0, &mdArg1, &mdArg2, &mdArg3, &mdArg4, &mdArg5};
+static const iocshFuncDef mdDef = { "md", 6, mdArgs };
 
 static void mdFunc(const iocshArgBuf *args)
 {
-    md(args[0].sval, args[1].ival, args[2].ival);
+    md(args[0].sval, args[1].ival, args[2].ival, args[3].ival, args[4].ival, args[5].sval);
 }
 
-static const iocshFuncDef mallocDef =
-    { "malloc", 1, (const iocshArg *[]) {
-    &(iocshArg) { "size", iocshArgString },
+static const iocshFuncDef mdwaitDef =
+    { "mdwait", 0, NULL };
+
+static void mdwaitFunc(const iocshArgBuf *args)
+{
+    (void)args;
+    memDisplayAsyncWait();
+}
+
+static const iocshFuncDef mdbatchDef =
+    { "mdbatch", 1, (const iocshArg *[]) {
+    &(iocshArg) { "filename", iocshArgString },
 }};
 
-static void mallocFunc(const iocshArgBuf *args)
+static void mdbatchFunc(const iocshArgBuf *args)
 {
-    void *p;
-    char b[20];
-    p = valloc(strToSize(args[0].sval, NULL));
-    sprintf(b, "%p", p);
-    epicsEnvSet("BUFFER", b);
-    printf("BUFFER = %s\n", b);
+    FILE* file;
+    char line[256];
+    char address[256];
+    memDisplayBatchItem* items = NULL;
+    size_t n = 0, nalloc = 0, i;
+    unsigned int lineno = 0;
+
+    if (!args[0].sval)
+    {
+        iocshCmd("help mdbatch");
+        return;
+    }
+    file = fopen(args[0].sval, "r");
+    if (!file)
+    {
+        fprintf(stderr, "Cannot open %s: %s\n", args[0].sval, strerror(errno));
+        return;
+    }
+    while (fgets(line, sizeof(line), file))
+    {
+        int wordsize = 0;
+        char count[64] = "1";
+
+        lineno++;
+        if (!strchr(line, '\n') && !feof(file))
+        {
+            fprintf(stderr, "%s line %u: line too long\n", args[0].sval, lineno);
+            goto end;
+        }
+        if (sscanf(line, " %255s %i %63s", address, &wordsize, count) < 1 || address[0] == '#')
+            continue;
+        if (n == nalloc)
+        {
+            memDisplayBatchItem* p;
+            nalloc = nalloc ? 2 * nalloc : 64;
+            p = realloc(items, nalloc * sizeof(memDisplayBatchItem));
+            if (!p)
+            {
+                fprintf(stderr, "Out of memory.\n");
+                goto end;
+            }
+            items = p;
+        }
+        items[n].address = epicsStrDup(address);
+        items[n].wordsize = wordsize;
+        items[n].count = strToSize(count, NULL);
+        n++;
+    }
+    if (ferror(file))
+    {
+        fprintf(stderr, "Error reading %s line %u: %s\n", args[0].sval, lineno, strerror(errno));
+        goto end;
+    }
+    fmemDisplayBatch(stdout, items, n);
+end:
+    fclose(file);
+    for (i = 0; i < n; i++)
+        free((char*)items[i].address);
+    free(items);
 }
 
 static const iocshFuncDef memfillDef =
@@ -244,13 +569,28 @@ static const iocshFuncDef memfillDef =
     &(iocshArg) { "increment", iocshArgInt },
 }};
 
+/* narrowest legal access width up to 4 which holds the pattern, -1 if none */
+static int fillWordsize(unsigned int caps, int pattern)
+{
+    unsigned int widths = caps & MEMDISPLAY_WIDTHS ? caps & MEMDISPLAY_WIDTHS : MEMDISPLAY_WIDTHS;
+    int wordsize = pattern & 0xffff0000 ? 4 : pattern & 0xff00 ? 2 : 1;
+
+    if (!caps) return 0;
+    while (wordsize < 4 && !(widths & wordsize)) wordsize <<= 1;
+    while (wordsize && !(widths & wordsize)) wordsize >>= 1;
+    if (!wordsize) return -1;
+    if (wordsize > 1 && memDisplayAutoWordsize(caps, MEMDISPLAY_RAM) < 0)
+        wordsize = -wordsize;
+    return wordsize;
+}
+
 static void memfillFunc(const iocshArgBuf *args)
 {
     int pattern;
     size_t size;
     int wordsize;
     int increment;
-    volatile void* address;
+    remote_addr_t address;
 
     if (!args[0].sval)
     {
@@ -260,8 +600,8 @@ static void memfillFunc(const iocshArgBuf *args)
     }
 
     size = strToSize(args[2].sval, NULL);
-    address = strToPtr(args[0].sval, size);
-    if (!address)
+    address = strToAddr(args[0].sval, 0, size);
+    if (!address.ptr)
     {
         fprintf(stderr, "Cannot map address %s\n", args[0].sval);
         return;
@@ -270,23 +610,32 @@ static void memfillFunc(const iocshArgBuf *args)
     pattern = args[1].ival;
     wordsize = args[3].ival;
     increment = args[4].ival;
-    memfill(address, pattern, size, wordsize, increment);
+    if (wordsize == 0 && (wordsize = fillWordsize(address.caps, pattern)) == -1)
+    {
+        fprintf(stderr, "No access width up to 4 bytes allowed for %s\n", args[0].sval);
+        return;
+    }
+    memfill(address.ptr, pattern, size, wordsize, increment);
 }
 
 static const iocshFuncDef memcopyDef =
-    { "memcopy", 4, (const iocshArg *[]) {
+    { "memcopy", 7, (const iocshArg *[]) {
     &(iocshArg) { "[addrspace:]source", iocshArgString },
     &(iocshArg) { "[addrspace:]dest", iocshArgString },
     &(iocshArg) { "size", iocshArgString },
     &(iocshArg) { "wordsize", iocshArgInt },
+    &(iocshArg) { "[threads]", iocshArgInt },
+    &(iocshArg) { "[cpus|nodeN]", iocshArgString },
+    &(iocshArg) { "[verify]", iocshArgInt },
 }};
 
 void memcopyFunc(const iocshArgBuf *args)
 {
-    volatile void* source;
-    volatile void* dest;
+    remote_addr_t source;
+    remote_addr_t dest;
     size_t size;
     int wordsize;
+    const char* cpus;
 
     if (!args[0].sval || !args[1].sval || !args[2].sval)
     {
@@ -295,36 +644,49 @@ void memcopyFunc(const iocshArgBuf *args)
     }
 
     size = strToSize(args[2].sval, NULL);
-    source = strToPtr(args[0].sval, size);
-    if (!source)
+    source = strToAddr(args[0].sval, 0, size);
+    if (!source.ptr)
     {
         fprintf(stderr, "Cannot map source address %s\n", args[0].sval);
         return;
     }
 
-    dest = strToPtr(args[1].sval, size);
-    if (!dest)
+    dest = strToAddr(args[1].sval, 0, size);
+    if (!dest.ptr)
     {
         fprintf(stderr, "Cannot map dest address %s\n", args[1].sval);
         return;
     }
 
     wordsize = args[3].ival;
-    memcopy(source, dest, size, wordsize);
+    if (wordsize == 0 && (wordsize = memDisplayAutoWordsize(source.caps, dest.caps)) == -1)
+    {
+        fprintf(stderr, "No common access width for %s and %s\n", args[0].sval, args[1].sval);
+        return;
+    }
+    cpus = args[5].sval && args[5].sval[0] ? args[5].sval : NULL;
+    if (args[6].ival)
+        memcopyVerify(source.ptr, dest.ptr, size, wordsize, args[4].ival, cpus);
+    else if (args[4].ival > 1 || cpus)
+        memcopyParallel(source.ptr, dest.ptr, size, wordsize, args[4].ival, cpus);
+    else
+        memcopy(source.ptr, dest.ptr, size, wordsize);
 }
 
 static const iocshFuncDef memcompDef =
-    { "memcomp", 4, (const iocshArg *[]) {
+    { "memcomp", 6, (const iocshArg *[]) {
     &(iocshArg) { "[addrspace:]source", iocshArgString },
     &(iocshArg) { "[addrspace:]dest", iocshArgString },
     &(iocshArg) { "size", iocshArgString },
     &(iocshArg) { "wordsize", iocshArgInt },
+    &(iocshArg) { "[ber]", iocshArgString },
+    &(iocshArg) { "[repeat]", iocshArgInt },
 }};
 
 static void memcompFunc(const iocshArgBuf *args)
 {
-    volatile void* source;
-    volatile void* dest;
+    remote_addr_t source;
+    remote_addr_t dest;
     size_t size;
     int wordsize;
 
@@ -333,32 +695,228 @@ static void memcompFunc(const iocshArgBuf *args)
         iocshCmd("help memcomp");
         return;
     }
+    if (args[4].sval && strcmp(args[4].sval, "ber") != 0)
+    {
+        fprintf(stderr, "Unknown compare mode %s\n", args[4].sval);
+        return;
+    }
 
     size = strToSize(args[2].sval, NULL);
-    source = strToPtr(args[0].sval, size);
-    if (!source)
+    source = strToAddr(args[0].sval, 0, size);
+    if (!source.ptr)
     {
         fprintf(stderr, "Cannot map source address %s\n", args[0].sval);
         return;
     }
 
-    dest = strToPtr(args[1].sval, size);
-    if (!dest)
+    dest = strToAddr(args[1].sval, 0, size);
+    if (!dest.ptr)
     {
         fprintf(stderr, "Cannot map dest address %s\n", args[1].sval);
         return;
     }
 
     wordsize = args[3].ival;
-    memcomp(source, dest, size, wordsize);
+    if (wordsize == 0 && (wordsize = memDisplayAutoWordsize(source.caps, dest.caps)) == -1)
+    {
+        fprintf(stderr, "No common access width for %s and %s\n", args[0].sval, args[1].sval);
+        return;
+    }
+    if (wordsize == 0 && !(source.caps & dest.caps & MEMDISPLAY_RAM))
+        wordsize = 1;
+    if (args[4].sval)
+        memcompBER(source.ptr, dest.ptr, size, wordsize, args[5].ival);
+    else if (wordsize == 0)
+        memcompRAM(source.ptr, dest.ptr, size);
+    else
+        memcomp(source.ptr, dest.ptr, size, wordsize);
+}
+
+static const iocshFuncDef memtestDef =
+    { "memtest", 6, (const iocshArg *[]) {
+    &(iocshArg) { "[addrspace:]address", iocshArgString },
+    &(iocshArg) { "size", iocshArgString },
+    &(iocshArg) { "[wordsize]", iocshArgInt },
+    &(iocshArg) { "[walk1,walk0,addr,check,random]", iocshArgString },
+    &(iocshArg) { "[passes]", iocshArgInt },
+    &(iocshArg) { "[threads]", iocshArgInt },
+}};
+
+static void memtestFunc(const iocshArgBuf *args)
+{
+    remote_addr_t address;
+    size_t size;
+    int wordsize;
+    int threads;
+    unsigned long long addr;
+    int invalid;
+    struct addressHandlerItem* hitem;
+
+    if (!args[0].sval || !args[1].sval)
+    {
+        iocshCmd("help memtest");
+        return;
+    }
+
+    size = strToSize(args[1].sval, NULL);
+    address = strToAddr(args[0].sval, 0, size);
+    if (!address.ptr)
+    {
+        fprintf(stderr, "Cannot map address %s\n", args[0].sval);
+        return;
+    }
+
+    wordsize = args[2].ival;
+    if (wordsize == 0)
+        wordsize = abs(memDisplayAutoWordsize(address.caps, MEMDISPLAY_RAM));
+
+    /* device address spaces are tested sequentially in burst order */
+    threads = args[5].ival;
+    if (threads <= 0 && (hitem = findAddrHandler(args[0].sval, &addr, &invalid)) != NULL &&
+            !(hitem->caps & MEMDISPLAY_RAM))
+        threads = 1;
+    memtest(address.offs, address.ptr, size, wordsize, args[3].sval, args[4].ival, threads);
+}
+
+static const iocshFuncDef memsnapDef =
+    { "memsnap", 4, (const iocshArg *[]) {
+    &(iocshArg) { "name", iocshArgString },
+    &(iocshArg) { "[addrspace:]address", iocshArgString },
+    &(iocshArg) { "size", iocshArgString },
+    &(iocshArg) { "[wordsize]", iocshArgInt },
+}};
+
+static void memsnapFunc(const iocshArgBuf *args)
+{
+    remote_addr_t addr;
+    size_t size;
+
+    if (!args[0].sval || !args[1].sval || !args[2].sval)
+    {
+        iocshCmd("help memsnap");
+        return;
+    }
+
+    size = strToSize(args[2].sval, NULL);
+    addr = strToAddr(args[1].sval, 0, size);
+    if (!addr.ptr)
+    {
+        fprintf(stderr, "Cannot map address %s\n", args[1].sval);
+        return;
+    }
+    memsnap(args[0].sval, addr.offs, addr.ptr, size,
+        args[3].ival ? args[3].ival : memDisplayAutoWordsize(addr.caps, MEMDISPLAY_RAM));
+}
+
+static const iocshFuncDef memdiffDef =
+    { "memdiff", 3, (const iocshArg *[]) {
+    &(iocshArg) { "name", iocshArgString },
+    &(iocshArg) { "[addrspace:]address|snap:name", iocshArgString },
+    &(iocshArg) { "[wordsize]", iocshArgInt },
+}};
+
+static void memdiffFunc(const iocshArgBuf *args)
+{
+    remote_addr_t addr;
+    size_t size;
+
+    if (!args[0].sval || !args[1].sval)
+    {
+        iocshCmd("help memdiff");
+        return;
+    }
+
+    if (strncmp(args[1].sval, "snap:", 5) == 0)
+    {
+        if (args[2].ival)
+        {
+            fprintf(stderr, "wordsize cannot be used with snap:\n");
+            return;
+        }
+        memdiffSnap(args[0].sval, args[1].sval + 5);
+        return;
+    }
+    size = memsnapSize(args[0].sval);
+    if (!size) return;
+    addr = strToAddr(args[1].sval, 0, size);
+    if (!addr.ptr)
+    {
+        fprintf(stderr, "Cannot map address %s\n", args[1].sval);
+        return;
+    }
+    memdiff(args[0].sval, addr.offs, addr.ptr, args[2].ival);
+}
+
+static const iocshFuncDef memsnapSaveDef =
+    { "memsnapSave", 2, (const iocshArg *[]) {
+    &(iocshArg) { "name", iocshArgString },
+    &(iocshArg) { "filename", iocshArgString },
+}};
+
+static void memsnapSaveFunc(const iocshArgBuf *args)
+{
+    if (!args[0].sval || !args[1].sval)
+    {
+        iocshCmd("help memsnapSave");
+        return;
+    }
+    memsnapSave(args[0].sval, args[1].sval);
+}
+
+static const iocshFuncDef memsnapLoadDef =
+    { "memsnapLoad", 2, (const iocshArg *[]) {
+    &(iocshArg) { "name", iocshArgString },
+    &(iocshArg) { "filename", iocshArgString },
+}};
+
+static void memsnapLoadFunc(const iocshArgBuf *args)
+{
+    if (!args[0].sval || !args[1].sval)
+    {
+        iocshCmd("help memsnapLoad");
+        return;
+    }
+    memsnapLoad(args[0].sval, args[1].sval);
+}
+
+static const iocshFuncDef memsnapFreeDef =
+    { "memsnapFree", 1, (const iocshArg *[]) {
+    &(iocshArg) { "name", iocshArgString },
+}};
+
+static void memsnapFreeFunc(const iocshArgBuf *args)
+{
+    if (!args[0].sval)
+    {
+        iocshCmd("help memsnapFree");
+        return;
+    }
+    memsnapFree(args[0].sval);
+}
+
+static const iocshFuncDef memsnapListDef =
+    { "memsnapList", 0, NULL };
+
+static void memsnapListFunc(const iocshArgBuf *args)
+{
+    (void)args;
+    memsnapList();
 }
 
 static void memDisplayRegistrar(void)
 {
     iocshRegister(&mdDef, mdFunc);
-    iocshRegister(&mallocDef, mallocFunc);
+    iocshRegister(&mdwaitDef, mdwaitFunc);
+    iocshRegister(&mdbatchDef, mdbatchFunc);
     iocshRegister(&memfillDef, memfillFunc);
     iocshRegister(&memcopyDef, memcopyFunc);
     iocshRegister(&memcompDef, memcompFunc);
+    iocshRegister(&memtestDef, memtestFunc);
+    iocshRegister(&memsnapDef, memsnapFunc);
+    iocshRegister(&memdiffDef, memdiffFunc);
+    iocshRegister(&memsnapSaveDef, memsnapSaveFunc);
+    iocshRegister(&memsnapLoadDef, memsnapLoadFunc);
+    iocshRegister(&memsnapFreeDef, memsnapFreeFunc);
+    iocshRegister(&memsnapListDef, memsnapListFunc);
 }
 epicsExportRegistrar(memDisplayRegistrar);
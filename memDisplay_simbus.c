@@ -0,0 +1,504 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+
+#if defined(__linux) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_simbus
+#include <unistd.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#endif
+
+#include <epicsString.h>
+#include <epicsStdioRedirect.h>
+#include <iocsh.h>
+
+#include "epicsExport.h"
+#include "memDisplay.h"
+#include "memDisplayPriv.h"
+
+#ifdef HAVE_simbus
+/* Simulated slow bus for testing.
+
+   The bus is backed by a temporary file mapped without access rights.
+   Every access traps. The fault filter checks the access width, waits
+   for the configured latency, unlocks the page and single-steps the
+   access instruction with the trap flag. The SIGTRAP handler locks
+   the page again. Thus each access costs a few microseconds plus the
+   configured latency, like a real slow bus.
+
+   Bus error regions are mapped beyond the end of an empty file,
+   which raises a real SIGBUS on access.
+
+   Page protection is process wide. While one thread single-steps an
+   access, other threads may access the same page without latency and
+   width checks. Thus the bus is meant to be used from one thread at
+   a time.
+*/
+
+struct simBus {
+    char* name;
+    char* base;
+    size_t size;
+    FILE* backing;          /* memory content */
+    FILE* empty;            /* pages mapped beyond its end raise SIGBUS */
+    long latency;           /* nsec per access */
+    unsigned int widths;    /* bit n set: access width 1<<n bytes allowed, 0: any */
+    unsigned long accesses;
+    unsigned long errors;
+    struct simBus* next;
+} *simBusList = NULL;
+
+static size_t simBusPageSize;
+
+#define WIDTH_BIT(w) ((w)==1?1:(w)==2?2:(w)==4?4:(w)==8?8:(w)==16?16:(w)==32?32:(w)==64?64:0)
+
+#ifdef __x86_64__
+#define REG_IP REG_RIP
+#else
+#define REG_IP REG_EIP
+#endif
+#define TRAP_FLAG 0x100
+
+/* pages unlocked for the instruction currently single-stepped */
+#define MAX_STEP_PAGES 4
+static __thread char* stepPages[MAX_STEP_PAGES];
+static __thread int stepCount;
+
+/* Decode the memory operand width of common x86 load and store
+   instructions. Returns 0 if unknown. */
+static int accessWidth(const unsigned char* ip)
+{
+    int opsize = 4, rexw = 0, vex = 0, vexl = 0, rep = 0;
+
+    while (1)
+    {
+        switch (*ip)
+        {
+            case 0x66:
+                opsize = 2;
+                ip++;
+                continue;
+            case 0xf2:
+            case 0xf3:
+                rep = *ip++;
+                continue;
+            case 0xf0:
+            case 0x67:
+            case 0x26:
+            case 0x2e:
+            case 0x36:
+            case 0x3e:
+            case 0x64:
+            case 0x65:
+                ip++;
+                continue;
+        }
+        break;
+    }
+#ifdef __x86_64__
+    if ((*ip & 0xf0) == 0x40)
+        rexw = *ip++ & 0x08;
+    switch (*ip)
+    {
+        case 0xc5: /* 2 byte VEX */
+            vex = 1;
+            vexl = ip[1] & 0x04;
+            rep = "\0\0\xf3\xf2"[ip[1] & 3] & 0xff;
+            ip += 2;
+            goto twobyte;
+        case 0xc4: /* 3 byte VEX */
+            if ((ip[1] & 0x1f) != 1) return 0;
+            vex = 1;
+            vexl = ip[2] & 0x04;
+            rexw = ip[2] & 0x80;
+            rep = "\0\0\xf3\xf2"[ip[2] & 3] & 0xff;
+            ip += 3;
+            goto twobyte;
+        case 0x62: /* EVEX */
+            if ((ip[1] & 0x03) != 1) return 0;
+            switch (ip[4])
+            {
+                case 0x10: case 0x11: case 0x28: case 0x29:
+                case 0x6f: case 0x7f: case 0xe7: case 0x2b:
+                    return 16 << ((ip[3] >> 5) & 3);
+            }
+            return 0;
+    }
+#endif
+    if (rexw) opsize = 8;
+    switch (*ip)
+    {
+        case 0x88: case 0x8a: case 0xc6: case 0x86:
+        case 0xa4: case 0xaa: case 0xac:
+        case 0x38: case 0x3a: case 0x84: case 0x80:
+        case 0xf6: case 0xfe:
+            return 1;
+        case 0x89: case 0x8b: case 0xc7: case 0x87:
+        case 0xa5: case 0xab: case 0xad:
+        case 0x39: case 0x3b: case 0x85: case 0x81: case 0x83:
+        case 0xf7: case 0xff:
+            return opsize;
+        case 0x63:
+            return 4;
+        case 0x0f:
+            ip++;
+            break;
+        default:
+            return 0;
+    }
+twobyte:
+    switch (*ip)
+    {
+        case 0xb6: case 0xbe:
+            return 1;
+        case 0xb7: case 0xbf:
+            return 2;
+        case 0xc3:
+            return rexw ? 8 : 4;
+        case 0x6e: case 0x7e:
+            return rep == 0xf3 || rexw ? 8 : 4;
+        case 0xd6: case 0x12: case 0x13: case 0x16: case 0x17:
+            return 8;
+        case 0x10: case 0x11:
+            if (rep == 0xf3) return 4;
+            if (rep == 0xf2) return 8;
+            /* fall through */
+        case 0x28: case 0x29: case 0x6f: case 0x7f: case 0xe7: case 0x2b:
+            return vex ? (vexl ? 32 : 16) : 16;
+    }
+    return 0;
+}
+
+static void simBusDelay(long nsec)
+{
+    struct timespec start, now;
+
+    if (nsec <= 0) return;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do clock_gettime(CLOCK_MONOTONIC, &now);
+    while ((now.tv_sec - start.tv_sec) * 1000000000L + now.tv_nsec - start.tv_nsec < nsec);
+}
+
+static struct simBus* simBusFind(const char* addr)
+{
+    struct simBus* bus;
+
+    for (bus = simBusList; bus != NULL; bus = bus->next)
+    {
+        if (addr >= bus->base && addr < bus->base + bus->size)
+            return bus;
+    }
+    return NULL;
+}
+
+static int simBusFilter(int sig, void* info, void* context)
+{
+    char* addr = ((siginfo_t*)info)->si_addr;
+    struct simBus* bus = simBusFind(addr);
+
+    if (!bus) return sig;
+    if (sig == SIGBUS)
+    {
+        __sync_fetch_and_add(&bus->errors, 1);
+        return sig;
+    }
+    if (sig == SIGSEGV && stepCount < MAX_STEP_PAGES)
+    {
+        ucontext_t* uc = context;
+        char* page = (char*)((size_t)addr & ~(simBusPageSize - 1));
+        int width = accessWidth((const unsigned char*)uc->uc_mcontext.gregs[REG_IP]);
+
+        if ((bus->widths && width && !(bus->widths & WIDTH_BIT(width))) ||
+            (width > 1 && width <= 8 && ((size_t)addr & (width - 1))))
+        {
+            /* illegal access width or misaligned access */
+            __sync_fetch_and_add(&bus->errors, 1);
+            return SIGBUS;
+        }
+        simBusDelay(bus->latency);
+        mprotect(page, simBusPageSize, PROT_READ | PROT_WRITE);
+        stepPages[stepCount++] = page;
+        uc->uc_mcontext.gregs[REG_EFL] |= TRAP_FLAG;
+        __sync_fetch_and_add(&bus->accesses, 1);
+        return 0;
+    }
+    return sig;
+}
+
+static struct sigaction oldsigsegv, oldsigtrap;
+
+static void simBusChain(int sig, int report, siginfo_t* info, void* context, struct sigaction* old)
+{
+    if (report == sig && (old->sa_flags & SA_SIGINFO))
+    {
+        old->sa_sigaction(sig, info, context);
+        return;
+    }
+    if (report == sig && old->sa_handler != SIG_DFL && old->sa_handler != SIG_IGN)
+    {
+        old->sa_handler(sig);
+        return;
+    }
+    /* default action: crash on the retried access or with the reported signal */
+    signal(sig, SIG_DFL);
+    if (report != sig)
+    {
+        signal(report, SIG_DFL);
+        raise(report);
+    }
+}
+
+static void simBusSegv(int sig, siginfo_t* info, void* context)
+{
+    int report = memDisplayFilterFault(sig, info, context);
+
+    if (report != 0)
+        simBusChain(sig, report, info, context, &oldsigsegv);
+}
+
+static void simBusTrap(int sig, siginfo_t* info, void* context)
+{
+    ucontext_t* uc = context;
+
+    if (!stepCount)
+    {
+        simBusChain(sig, sig, info, context, &oldsigtrap);
+        return;
+    }
+    while (stepCount)
+        mprotect(stepPages[--stepCount], simBusPageSize, PROT_NONE);
+    uc->uc_mcontext.gregs[REG_EFL] &= ~TRAP_FLAG;
+}
+
+static void simBusInstallHandlers(void)
+{
+    struct sigaction sa = {{0}};
+
+    if (simBusPageSize) return;
+    simBusPageSize = sysconf(_SC_PAGESIZE);
+    memDisplayInstallFaultFilter(simBusFilter);
+    sa.sa_flags = SA_SIGINFO;
+    sa.sa_sigaction = simBusSegv;
+    sigaction(SIGSEGV, &sa, &oldsigsegv);
+    sa.sa_sigaction = simBusTrap;
+    sigaction(SIGTRAP, &sa, &oldsigtrap);
+}
+
+static volatile void* simBusMap(size_t addr, size_t size, size_t usr)
+{
+    struct simBus* bus = (struct simBus*)usr;
+
+    if (addr > bus->size || size > bus->size - addr)
+    {
+        errno = ERANGE;
+        return NULL;
+    }
+    return bus->base + addr;
+}
+
+static struct simBus* simBusCreate(const char* name, size_t size, long latency, const char* widths)
+{
+    struct simBus* bus;
+    const char* p = widths;
+    char* q;
+
+    for (bus = simBusList; bus != NULL; bus = bus->next)
+    {
+        if (strcmp(bus->name, name) == 0)
+        {
+            fprintf(stderr, "Simulated bus %s already exists.\n", name);
+            return NULL;
+        }
+    }
+    bus = calloc(1, sizeof(struct simBus));
+    if (!bus)
+    {
+        fprintf(stderr, "Out of memory.\n");
+        return NULL;
+    }
+    while (p && *p)
+    {
+        int w = strtol(p, &q, 0);
+        if (q == p || !WIDTH_BIT(w) || (*q && *q != ','))
+        {
+            fprintf(stderr, "Invalid access widths %s\n", widths);
+            free(bus);
+            return NULL;
+        }
+        bus->widths |= WIDTH_BIT(w);
+        p = *q ? q+1 : q;
+    }
+    simBusInstallHandlers();
+    bus->size = (size + simBusPageSize - 1) & ~(simBusPageSize - 1);
+    bus->latency = latency;
+    bus->backing = tmpfile();
+    bus->empty = tmpfile();
+    if (!bus->backing || !bus->empty || ftruncate(fileno(bus->backing), bus->size) != 0)
+    {
+        fprintf(stderr, "Creating backing file failed: %s\n", strerror(errno));
+        goto fail;
+    }
+    bus->base = mmap(NULL, bus->size, PROT_NONE, MAP_SHARED, fileno(bus->backing), 0);
+    if (bus->base == MAP_FAILED)
+    {
+        fprintf(stderr, "mmap failed: %s\n", strerror(errno));
+        goto fail;
+    }
+    bus->name = epicsStrDup(name);
+    bus->next = simBusList;
+    simBusList = bus;
+    memDisplayInstallAddrHandlerCaps(name, simBusMap, (size_t)bus, bus->widths & MEMDISPLAY_WIDTHS);
+    return bus;
+fail:
+    if (bus->backing) fclose(bus->backing);
+    if (bus->empty) fclose(bus->empty);
+    free(bus);
+    return NULL;
+}
+
+static int simBusSetError(struct simBus* bus, size_t offset, size_t size, int clear)
+{
+    size_t end;
+    char* p;
+
+    if (size == 0 || size > bus->size || offset > bus->size - size)
+    {
+        fprintf(stderr, "Region exceeds simulated bus %s size 0x%llx.\n",
+            bus->name, (unsigned long long)bus->size);
+        return -1;
+    }
+    end = offset + size;
+    offset &= ~(simBusPageSize - 1);
+    end = (end + simBusPageSize - 1) & ~(simBusPageSize - 1);
+    if (end > bus->size)
+    {
+        fprintf(stderr, "Region exceeds simulated bus %s size 0x%llx.\n",
+            bus->name, (unsigned long long)bus->size);
+        return -1;
+    }
+    if (clear)
+        p = mmap(bus->base + offset, end - offset, PROT_NONE,
+            MAP_SHARED | MAP_FIXED, fileno(bus->backing), offset);
+    else
+        p = mmap(bus->base + offset, end - offset, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_FIXED, fileno(bus->empty), 0);
+    if (p == MAP_FAILED)
+    {
+        fprintf(stderr, "mmap failed: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static struct simBus* simBusByName(const char* name)
+{
+    struct simBus* bus;
+
+    for (bus = simBusList; bus != NULL; bus = bus->next)
+    {
+        if (strcmp(bus->name, name) == 0)
+            return bus;
+    }
+    fprintf(stderr, "Unknown simulated bus %s\n", name);
+    return NULL;
+}
+
+static void simBusShow(struct simBus* bus)
+{
+    char b[80];
+    int w;
+
+    printf("%-8s %p %s latency %ld ns widths", bus->name, bus->base,
+        sizeToStr(bus->size, b), bus->latency);
+    if (!bus->widths) printf(" any");
+    for (w = 1; w <= 64; w <<= 1)
+        if (bus->widths & WIDTH_BIT(w)) printf(" %d", w);
+    printf(" accesses %lu errors %lu\n", bus->accesses, bus->errors);
+}
+#endif
+
+static const iocshFuncDef simbusCreateDef =
+    { "simbusCreate", 4, (const iocshArg *[]) {
+    &(iocshArg) { "name", iocshArgString },
+    &(iocshArg) { "size", iocshArgString },
+    &(iocshArg) { "[latency/ns]", iocshArgInt },
+    &(iocshArg) { "[widths e.g. 2,4]", iocshArgString },
+}};
+
+static void simbusCreateFunc(const iocshArgBuf *args)
+{
+    if (!args[0].sval || !args[1].sval)
+    {
+        iocshCmd("help simbusCreate");
+        return;
+    }
+#ifdef HAVE_simbus
+    simBusCreate(args[0].sval, strToSize(args[1].sval, NULL), args[2].ival, args[3].sval);
+#else
+    fprintf(stderr, "Simulated bus not supported on this system.\n");
+#endif
+}
+
+static const iocshFuncDef simbusErrorDef =
+    { "simbusError", 4, (const iocshArg *[]) {
+    &(iocshArg) { "name", iocshArgString },
+    &(iocshArg) { "offset", iocshArgString },
+    &(iocshArg) { "size", iocshArgString },
+    &(iocshArg) { "[clear]", iocshArgInt },
+}};
+
+static void simbusErrorFunc(const iocshArgBuf *args)
+{
+#ifdef HAVE_simbus
+    struct simBus* bus;
+#endif
+
+    if (!args[0].sval || !args[1].sval || !args[2].sval)
+    {
+        iocshCmd("help simbusError");
+        return;
+    }
+#ifdef HAVE_simbus
+    if ((bus = simBusByName(args[0].sval)) != NULL)
+        simBusSetError(bus, strToSize(args[1].sval, NULL), strToSize(args[2].sval, NULL), args[3].ival);
+#else
+    fprintf(stderr, "Simulated bus not supported on this system.\n");
+#endif
+}
+
+static const iocshFuncDef simbusInfoDef =
+    { "simbusInfo", 1, (const iocshArg *[]) {
+    &(iocshArg) { "[name]", iocshArgString },
+}};
+
+static void simbusInfoFunc(const iocshArgBuf *args)
+{
+#ifdef HAVE_simbus
+    struct simBus* bus;
+
+    if (args[0].sval)
+    {
+        if ((bus = simBusByName(args[0].sval)) != NULL)
+            simBusShow(bus);
+        return;
+    }
+    for (bus = simBusList; bus != NULL; bus = bus->next)
+        simBusShow(bus);
+#endif
+}
+
+static void memDisplaySimBusRegistrar(void)
+{
+    iocshRegister(&simbusCreateDef, simbusCreateFunc);
+    iocshRegister(&simbusErrorDef, simbusErrorFunc);
+    iocshRegister(&simbusInfoDef, simbusInfoFunc);
+}
+epicsExportRegistrar(memDisplaySimBusRegistrar);
@@ -0,0 +1,468 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#define HAVE_inttypes
+#endif
+
+#ifdef __unix
+#define HAVE_inttypes
+#endif
+
+#ifdef HAVE_inttypes
+#include <inttypes.h>
+#else
+#define UINT64_C(c) c ## ULL
+typedef unsigned long long uint64_t;
+#endif
+
+#include "epicsExport.h"
+#include "memDisplay.h"
+#include "memDisplayPriv.h"
+
+/* Snapshots of memory regions with a hash per block for fast diffs */
+
+#define SNAP_BLOCK_SIZE 4096
+#define SNAP_MAGIC "memsnap1"
+
+static struct snapshot {
+    char* name;
+    size_t base;            /* address for display */
+    size_t size;
+    int wordsize;
+    char* data;             /* in host byte order */
+    uint64_t* hash;         /* one per block */
+    struct snapshot* next;
+} *snapshotList = NULL;
+
+struct snapshotFileHeader {
+    char magic[8];
+    uint64_t base;
+    uint64_t size;
+    uint64_t wordsize;
+    uint64_t blocksize;
+};
+
+static uint64_t blockHash(const char* data, size_t size)
+{
+    /* 4 independent multiply chains per 32 bytes, then mixed */
+    uint64_t h[4] = { size, UINT64_C(0x9e3779b97f4a7c15), UINT64_C(0xbf58476d1ce4e5b9), UINT64_C(0x94d049bb133111eb) };
+    uint64_t w[4];
+    size_t i;
+    int j;
+
+    for (i = 0; i + 32 <= size; i += 32)
+    {
+        memcpy(w, data + i, 32);
+        for (j = 0; j < 4; j++)
+        {
+            h[j] = (h[j] ^ w[j]) * UINT64_C(0x100000001b3);
+            h[j] ^= h[j] >> 29;
+        }
+    }
+    if (i < size)
+    {
+        memset(w, 0, sizeof(w));
+        memcpy(w, data + i, size - i);
+        for (j = 0; j < 4; j++)
+            h[j] = (h[j] ^ w[j]) * UINT64_C(0x100000001b3);
+    }
+    for (j = 1; j < 4; j++)
+    {
+        h[0] ^= h[j] + UINT64_C(0x9e3779b97f4a7c15) + (h[0] << 6) + (h[0] >> 2);
+    }
+    h[0] = (h[0] ^ (h[0] >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    h[0] = (h[0] ^ (h[0] >> 27)) * UINT64_C(0x94d049bb133111eb);
+    return h[0] ^ (h[0] >> 31);
+}
+
+static size_t snapBlocks(size_t size)
+{
+    return (size + SNAP_BLOCK_SIZE - 1) / SNAP_BLOCK_SIZE;
+}
+
+static void snapHash(struct snapshot* snap)
+{
+    size_t i;
+
+    for (i = 0; i < snapBlocks(snap->size); i++)
+    {
+        size_t offs = i * SNAP_BLOCK_SIZE;
+        size_t len = snap->size - offs < SNAP_BLOCK_SIZE ? snap->size - offs : SNAP_BLOCK_SIZE;
+        snap->hash[i] = blockHash(snap->data + offs, len);
+    }
+}
+
+static struct snapshot* snapFind(const char* name)
+{
+    struct snapshot* snap;
+
+    for (snap = snapshotList; snap != NULL; snap = snap->next)
+    {
+        if (strcmp(snap->name, name) == 0)
+            return snap;
+    }
+    fprintf(stderr, "Unknown snapshot %s\n", name);
+    return NULL;
+}
+
+static void snapRelease(struct snapshot* snap)
+{
+    free(snap->name);
+    free(snap->data);
+    free(snap->hash);
+    free(snap);
+}
+
+static struct snapshot* snapCreate(const char* name, size_t base, size_t size, int wordsize)
+{
+    struct snapshot* snap = calloc(1, sizeof(struct snapshot));
+
+    if (!snap ||
+        !(snap->name = malloc(strlen(name) + 1)) ||
+        !(snap->data = malloc(size ? size : 1)) ||
+        !(snap->hash = malloc((snapBlocks(size) + 1) * sizeof(uint64_t))))
+    {
+        if (snap) snapRelease(snap);
+        fprintf(stderr, "Out of memory.\n");
+        return NULL;
+    }
+    strcpy(snap->name, name);
+    snap->base = base;
+    snap->size = size;
+    snap->wordsize = wordsize;
+    return snap;
+}
+
+/* replaces an existing snapshot of the same name */
+static void snapInsert(struct snapshot* snap)
+{
+    struct snapshot** psnap;
+
+    for (psnap = &snapshotList; *psnap != NULL; psnap = &(*psnap)->next)
+    {
+        if (strcmp((*psnap)->name, snap->name) == 0)
+        {
+            struct snapshot* old = *psnap;
+            snap->next = old->next;
+            *psnap = snap;
+            snapRelease(old);
+            return;
+        }
+    }
+    snap->next = snapshotList;
+    snapshotList = snap;
+}
+
+static int snapRead(char* data, const volatile void* ptr, size_t size, int wordsize)
+{
+    memReadVector vec;
+
+    vec.ptr = ptr;
+    vec.wordsize = wordsize;
+    vec.count = size / abs(wordsize);
+    vec.data = data;
+    return memreadv(&vec, 1);
+}
+
+static int snapCheckWordsize(int wordsize)
+{
+    switch (wordsize)
+    {
+        case 1:
+        case 2:
+        case 4:
+        case 8:
+        case -1:
+        case -2:
+        case -4:
+        case -8:
+            return 0;
+        default:
+            fprintf(stderr, "Illegal wordsize %d: must be 1, 2, 4, 8, -2, -4, -8\n", wordsize);
+            return -1;
+    }
+}
+
+int memsnap(const char* name, size_t base, const volatile void* ptr, size_t size, int wordsize)
+{
+    struct snapshot* snap;
+
+    if (!wordsize) wordsize = 4;
+    if (snapCheckWordsize(wordsize) != 0)
+        return -1;
+    size &= ~(size_t)(abs(wordsize) - 1);
+    snap = snapCreate(name, base, size, wordsize);
+    if (!snap) return -1;
+    if (snapRead(snap->data, ptr, size, wordsize) != 0)
+    {
+        snapRelease(snap);
+        return -1;
+    }
+    snapHash(snap);
+    snapInsert(snap);
+    return 0;
+}
+
+/* print the 16 byte lines of a block which differ */
+static int snapPrintDiff(FILE* file, const char* oldname, size_t oldbase, const char* olddata,
+    const char* newname, size_t newbase, const char* newdata, size_t len, int wordsize)
+{
+    size_t i, j, n;
+    int lines = 0;
+
+    for (i = 0; i < len; i = j)
+    {
+        n = len - i < 16 ? len - i : 16;
+        if (memcmp(olddata + i, newdata + i, n) == 0)
+        {
+            j = i + n;
+            continue;
+        }
+        /* merge consecutive differing lines */
+        for (j = i + n; j < len; j += n)
+        {
+            n = len - j < 16 ? len - j : 16;
+            if (memcmp(olddata + j, newdata + j, n) == 0) break;
+        }
+        fprintf(file, "%s:\n", oldname);
+        memDisplayFormatData(file, oldbase + i, olddata + i, abs(wordsize), j - i);
+        fprintf(file, "%s:\n", newname);
+        memDisplayFormatData(file, newbase + i, newdata + i, abs(wordsize), j - i);
+        lines++;
+    }
+    return lines;
+}
+
+static void snapSummary(size_t blocks, size_t diffblocks)
+{
+    if (diffblocks)
+        printf("%llu of %llu blocks differ\n", (unsigned long long)diffblocks, (unsigned long long)blocks);
+    else
+        printf("OK\n");
+}
+
+/* live memory is read in batches of blocks */
+#define SNAP_READ_BLOCKS 64
+
+int memdiff(const char* name, size_t base, const volatile void* ptr, int wordsize)
+{
+    struct snapshot* snap = snapFind(name);
+    char* buffer;
+    size_t i, diffblocks = 0;
+
+    if (!snap) return -1;
+    if (!wordsize) wordsize = snap->wordsize;
+    if (snapCheckWordsize(wordsize) != 0)
+        return -1;
+    buffer = malloc(SNAP_READ_BLOCKS * SNAP_BLOCK_SIZE);
+    if (!buffer)
+    {
+        fprintf(stderr, "Out of memory.\n");
+        return -1;
+    }
+    for (i = 0; i < snapBlocks(snap->size); i++)
+    {
+        size_t offs = i * SNAP_BLOCK_SIZE;
+        size_t len = snap->size - offs < SNAP_BLOCK_SIZE ? snap->size - offs : SNAP_BLOCK_SIZE;
+        char* block = buffer + (i % SNAP_READ_BLOCKS) * SNAP_BLOCK_SIZE;
+
+        if (i % SNAP_READ_BLOCKS == 0)
+        {
+            size_t batch = snap->size - offs < SNAP_READ_BLOCKS * SNAP_BLOCK_SIZE ?
+                snap->size - offs : SNAP_READ_BLOCKS * SNAP_BLOCK_SIZE;
+            if (snapRead(buffer, (const volatile char*)ptr + offs, batch, wordsize) != 0)
+            {
+                free(buffer);
+                return -1;
+            }
+        }
+        if (blockHash(block, len) == snap->hash[i])
+            continue;
+        if (snapPrintDiff(stdout, snap->name, snap->base + offs, snap->data + offs,
+                "live", base + offs, block, len, wordsize))
+            diffblocks++;
+    }
+    free(buffer);
+    snapSummary(snapBlocks(snap->size), diffblocks);
+    return diffblocks != 0;
+}
+
+int memdiffSnap(const char* name, const char* other)
+{
+    struct snapshot* snap = snapFind(name);
+    struct snapshot* snap2 = snapFind(other);
+    size_t i, size, diffblocks = 0;
+
+    if (!snap || !snap2) return -1;
+    size = snap->size;
+    if (snap2->size != size)
+    {
+        fprintf(stderr, "Snapshot sizes differ, comparing 0x%llx bytes.\n",
+            (unsigned long long)(size < snap2->size ? size : snap2->size));
+        if (snap2->size < size) size = snap2->size;
+    }
+    for (i = 0; i < snapBlocks(size); i++)
+    {
+        size_t offs = i * SNAP_BLOCK_SIZE;
+        size_t len = size - offs < SNAP_BLOCK_SIZE ? size - offs : SNAP_BLOCK_SIZE;
+
+        /* the hash of a partial last block is only comparable if both end there */
+        if (len == SNAP_BLOCK_SIZE || snap->size == snap2->size)
+            if (snap->hash[i] == snap2->hash[i]) continue;
+        if (snapPrintDiff(stdout, snap->name, snap->base + offs, snap->data + offs,
+                snap2->name, snap2->base + offs, snap2->data + offs, len, snap->wordsize))
+            diffblocks++;
+    }
+    snapSummary(snapBlocks(size), diffblocks);
+    return diffblocks != 0;
+}
+
+int memsnapSave(const char* name, const char* filename)
+{
+    struct snapshot* snap = snapFind(name);
+    struct snapshotFileHeader header;
+    FILE* file;
+
+    if (!snap) return -1;
+    file = fopen(filename, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "Cannot open %s: %s\n", filename, strerror(errno));
+        return -1;
+    }
+    memcpy(header.magic, SNAP_MAGIC, sizeof(header.magic));
+    header.base = snap->base;
+    header.size = snap->size;
+    header.wordsize = snap->wordsize;
+    header.blocksize = SNAP_BLOCK_SIZE;
+    if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+        fwrite(snap->data, 1, snap->size, file) != snap->size)
+    {
+        fprintf(stderr, "Writing %s failed: %s\n", filename, strerror(errno));
+        fclose(file);
+        remove(filename);
+        return -1;
+    }
+    if (fclose(file) != 0)
+    {
+        fprintf(stderr, "Writing %s failed: %s\n", filename, strerror(errno));
+        remove(filename);
+        return -1;
+    }
+    return 0;
+}
+
+/* check the header against the data which follows in the file */
+static int snapCheckHeader(const struct snapshotFileHeader* header, FILE* file)
+{
+    long start, end;
+    int wordsize = (int)(long long)header->wordsize;
+
+    if (memcmp(header->magic, SNAP_MAGIC, sizeof(header->magic)) != 0 ||
+        header->size != (size_t)header->size)
+        return -1;
+    if ((unsigned long long)(long long)wordsize != header->wordsize)
+        return -1;
+    switch (wordsize)
+    {
+        case 1:
+        case 2:
+        case 4:
+        case 8:
+        case -1:
+        case -2:
+        case -4:
+        case -8:
+            break;
+        default:
+            return -1;
+    }
+    if (header->size % abs(wordsize) != 0)
+        return -1;
+    if (header->blocksize == 0 || (header->blocksize & (header->blocksize - 1)) != 0)
+        return -1;
+    start = ftell(file);
+    if (start < 0 || fseek(file, 0, SEEK_END) != 0)
+        return -1;
+    end = ftell(file);
+    if (end < 0 || (unsigned long long)(end - start) != header->size ||
+        fseek(file, start, SEEK_SET) != 0)
+        return -1;
+    return 0;
+}
+
+int memsnapLoad(const char* name, const char* filename)
+{
+    struct snapshot* snap;
+    struct snapshotFileHeader header;
+    FILE* file;
+
+    file = fopen(filename, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "Cannot open %s: %s\n", filename, strerror(errno));
+        return -1;
+    }
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        snapCheckHeader(&header, file) != 0)
+    {
+        fprintf(stderr, "%s is not a valid snapshot file\n", filename);
+        fclose(file);
+        return -1;
+    }
+    snap = snapCreate(name, (size_t)header.base, (size_t)header.size, (int)(long long)header.wordsize);
+    if (!snap)
+    {
+        fclose(file);
+        return -1;
+    }
+    if (fread(snap->data, 1, snap->size, file) != snap->size)
+    {
+        fprintf(stderr, "Reading %s failed: %s\n", filename, ferror(file) ? strerror(errno) : "file too short");
+        fclose(file);
+        snapRelease(snap);
+        return -1;
+    }
+    fclose(file);
+    snapHash(snap);
+    snapInsert(snap);
+    return 0;
+}
+
+int memsnapFree(const char* name)
+{
+    struct snapshot** psnap;
+
+    for (psnap = &snapshotList; *psnap != NULL; psnap = &(*psnap)->next)
+    {
+        if (strcmp((*psnap)->name, name) == 0)
+        {
+            struct snapshot* snap = *psnap;
+            *psnap = snap->next;
+            snapRelease(snap);
+            return 0;
+        }
+    }
+    fprintf(stderr, "Unknown snapshot %s\n", name);
+    return -1;
+}
+
+size_t memsnapSize(const char* name)
+{
+    struct snapshot* snap = snapFind(name);
+
+    return snap ? snap->size : 0;
+}
+
+void memsnapList(void)
+{
+    struct snapshot* snap;
+    char b[80];
+
+    for (snap = snapshotList; snap != NULL; snap = snap->next)
+        printf("%-12s base 0x%llx size %s wordsize %d\n", snap->name,
+            (unsigned long long)snap->base, sizeToStr(snap->size, b), snap->wordsize);
+}